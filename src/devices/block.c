@@ -3,7 +3,11 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/iosched.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A block device. */
 struct block
@@ -17,8 +21,16 @@ struct block
     const struct block_operations *ops;  /* Driver operations. */
     void *aux;                          /* Extra data owned by driver. */
 
-    unsigned long long read_cnt;        /* Number of sectors read. */
-    unsigned long long write_cnt;       /* Number of sectors written. */
+    struct block *target;               /* For a window, device under it. */
+    block_sector_t start;               /* For a window, its first sector
+                                           within TARGET. */
+
+    const struct iosched *sched;        /* I/O scheduler. */
+    struct block_queue *queue;          /* Request queue, created at the
+                                           first queued request. */
+
+    struct block_stats stats;           /* Statistics, updated with
+                                           interrupts off. */
   };
 
 /* List of all block devices. */
@@ -27,6 +39,10 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 /* The block block assigned to each Pintos role. */
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
+/* Serializes creation of request queues.  Initialized by the first
+   block_register(), which runs at boot. */
+static struct lock queue_lock;
+
 static struct block *list_elem_to_block (struct list_elem *);
 
 /* Returns a human-readable name for the given block device
@@ -113,6 +129,251 @@ check_sector (struct block *block, block_sector_t sector)
     }
 }
 
+/* Passes the transfer of CNT sectors starting at SECTOR between
+   BLOCK and BUFFER to BLOCK's driver, into BUFFER if WRITE is
+   false and out of it if WRITE is true. */
+void
+block_driver_io (struct block *block, block_sector_t sector, size_t cnt,
+                 void *buffer, bool write)
+{
+  size_t i;
+
+  if (write && block->ops->write_multiple != NULL)
+    block->ops->write_multiple (block->aux, sector, cnt, buffer);
+  else if (!write && block->ops->read_multiple != NULL)
+    block->ops->read_multiple (block->aux, sector, cnt, buffer);
+  else
+    for (i = 0; i < cnt; i++)
+      {
+        uint8_t *p = (uint8_t *) buffer + i * BLOCK_SECTOR_SIZE;
+        if (write)
+          block->ops->write (block->aux, sector + i, p);
+        else
+          block->ops->read (block->aux, sector + i, p);
+      }
+}
+
+/* Returns BLOCK's request queue, creating it if necessary. */
+static struct block_queue *
+get_queue (struct block *block)
+{
+  if (block->queue == NULL)
+    {
+      lock_acquire (&queue_lock);
+      if (block->queue == NULL)
+        block->queue = block_queue_create (block, block->sched);
+      lock_release (&queue_lock);
+    }
+  return block->queue;
+}
+
+/* Verifies that the CNT sectors starting at SECTOR all lie within
+   BLOCK.  Panics if not. */
+static void
+check_sectors (struct block *block, block_sector_t sector, size_t cnt)
+{
+  ASSERT (cnt > 0);
+  check_sector (block, sector);
+  if (cnt > block->size - sector)
+    PANIC ("Access past end of device %s (sector=%"PRDSNu", count=%zu, "
+           "size=%"PRDSNu")\n", block_name (block), sector, cnt,
+           block->size);
+}
+
+/* Returns the index of the most significant bit set in X, which
+   must be nonzero. */
+static int
+log2_floor (uint64_t x)
+{
+  int bit = 0;
+
+  ASSERT (x != 0);
+  while (x >>= 1)
+    bit++;
+  return bit;
+}
+
+/* Adds 1 to the power-of-2 bucket of HISTOGRAM, which has CNT
+   buckets, that X falls into.  Bucket I counts values from 2**I
+   to 2**(I+1) - 1, except that 0 goes in bucket 0 and values too
+   big for the last bucket go in it too. */
+static void
+histogram_add (unsigned histogram[], int cnt, uint64_t x)
+{
+  int bucket = x != 0 ? log2_floor (x) : 0;
+  histogram[bucket < cnt ? bucket : cnt - 1]++;
+}
+
+/* Updates BLOCK's statistics for REQ, just submitted to it. */
+static void
+account_submit (struct block *block, const struct block_request *req)
+{
+  struct block_stats *s = &block->stats;
+  enum intr_level old_level = intr_disable ();
+
+  if (req->write)
+    {
+      s->write_reqs++;
+      s->write_cnt += req->cnt;
+    }
+  else
+    {
+      s->read_reqs++;
+      s->read_cnt += req->cnt;
+    }
+  histogram_add (s->size, BLOCK_SIZE_BUCKETS, req->cnt);
+  s->depth[s->in_flight < BLOCK_DEPTH_BUCKETS
+           ? s->in_flight : BLOCK_DEPTH_BUCKETS - 1]++;
+  s->in_flight++;
+
+  intr_set_level (old_level);
+}
+
+/* Updates the statistics of the device REQ was submitted to, and
+   of the devices under it, for REQ's completion. */
+static void
+account_complete (const struct block_request *req)
+{
+  uint64_t queue_time = req->dispatch_time - req->submit_time;
+  uint64_t service_time = rdtsc () - req->dispatch_time;
+  enum intr_level old_level = intr_disable ();
+  struct block *block;
+
+  for (block = req->block; block != NULL; block = block->target)
+    {
+      struct block_stats *s = &block->stats;
+
+      s->queue_cycles += queue_time;
+      s->service_cycles += service_time;
+      histogram_add (s->queue_latency, BLOCK_LATENCY_BUCKETS, queue_time);
+      histogram_add (s->service_latency, BLOCK_LATENCY_BUCKETS,
+                     service_time);
+      s->in_flight--;
+    }
+
+  intr_set_level (old_level);
+}
+
+/* Initializes REQ to transfer the CNT sectors starting at SECTOR
+   between a block device and BUFFER, which holds CNT *
+   BLOCK_SECTOR_SIZE bytes: into BUFFER if WRITE is false, out of
+   it if WRITE is true.
+
+   If COMPLETE is non-null, it is called with REQ once the
+   transfer is over, from the thread that finished it, which may
+   be the submitter; it must not wait for I/O on the device.  REQ
+   then belongs to COMPLETE, which may free it.  Otherwise, wait
+   for REQ with block_wait().  AUX is for COMPLETE's use. */
+void
+block_request_init (struct block_request *req, block_sector_t sector,
+                    size_t cnt, void *buffer, bool write,
+                    block_complete_func *complete, void *aux)
+{
+  req->sector = sector;
+  req->cnt = cnt;
+  req->buffer = buffer;
+  req->write = write;
+  req->complete = complete;
+  req->aux = aux;
+  req->done = false;
+  sema_init (&req->done_sema, 0);
+}
+
+/* Starts REQ on BLOCK and returns, usually before the transfer is
+   over.  Requests to a window go to the device under it.  The
+   transfer runs in BLOCK's dispatch thread, or at once in the
+   calling thread if BLOCK's scheduler is "none", unless BLOCK's
+   driver takes requests itself through its submit operation.
+   Panics if REQ lies past the end of BLOCK. */
+void
+block_submit (struct block *block, struct block_request *req)
+{
+  req->block = block;
+  req->dev_sector = req->sector;
+  req->submit_time = rdtsc ();
+  for (;;)
+    {
+      check_sectors (block, req->dev_sector, req->cnt);
+      ASSERT (!req->write || block->type != BLOCK_FOREIGN);
+      account_submit (block, req);
+
+      if (block->target == NULL)
+        break;
+      req->dev_sector += block->start;
+      block = block->target;
+    }
+
+  if (block->ops->submit != NULL)
+    {
+      req->dispatch_time = rdtsc ();
+      block->ops->submit (block->aux, req);
+    }
+  else if (iosched_queues (block->sched))
+    block_queue_submit (get_queue (block), req);
+  else
+    {
+      req->dispatch_time = rdtsc ();
+      block_driver_io (block, req->dev_sector, req->cnt, req->buffer,
+                       req->write);
+      block_complete (req);
+    }
+}
+
+/* Marks REQ's transfer as over: calls its COMPLETE function, or
+   wakes up block_wait(). */
+void
+block_complete (struct block_request *req)
+{
+  account_complete (req);
+
+  if (req->complete != NULL)
+    {
+      req->done = true;
+      req->complete (req);
+    }
+  else
+    {
+      /* Set DONE and up the semaphore atomically, so that once
+         block_request_done() is true, block_wait() cannot block
+         and REQ can be reused. */
+      enum intr_level old_level = intr_disable ();
+      req->done = true;
+      sema_up (&req->done_sema);
+      intr_set_level (old_level);
+    }
+}
+
+/* Waits for REQ, which must have been submitted without a
+   COMPLETE function, to be over.  May be called more than once. */
+void
+block_wait (struct block_request *req)
+{
+  ASSERT (req->complete == NULL);
+  sema_down (&req->done_sema);
+  sema_up (&req->done_sema);
+}
+
+/* Returns true if REQ's transfer is over. */
+bool
+block_request_done (const struct block_request *req)
+{
+  return req->done;
+}
+
+/* Transfers CNT sectors starting at SECTOR between BLOCK and
+   BUFFER, as block_request_init() describes, and returns when
+   done. */
+static void
+block_transfer (struct block *block, block_sector_t sector, size_t cnt,
+                void *buffer, bool write)
+{
+  struct block_request req;
+
+  block_request_init (&req, sector, cnt, buffer, write, NULL, NULL);
+  block_submit (block, &req);
+  block_wait (&req);
+}
+
 /* Reads sector SECTOR from BLOCK into BUFFER, which must
    have room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to block devices, so external
@@ -120,9 +381,7 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  block_transfer (block, sector, 1, buffer, false);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +392,66 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  block_transfer (block, sector, 1, (void *) buffer, true);
+}
+
+/* Reads the CNT sectors starting at SECTOR from BLOCK into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE bytes.
+   Drivers that can move several sectors per command do so, so
+   prefer this to CNT calls to block_read().
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                     void *buffer)
+{
+  block_transfer (block, sector, cnt, buffer, false);
+}
+
+/* Writes the CNT sectors starting at SECTOR to BLOCK from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes.  Returns
+   after the block device has acknowledged receiving the data.
+   Drivers that can move several sectors per command do so, so
+   prefer this to CNT calls to block_write().
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                      const void *buffer)
+{
+  block_transfer (block, sector, cnt, (void *) buffer, true);
+}
+
+/* Makes BLOCK's requests follow the I/O scheduler called NAME
+   from now on.  Drivers that only pass requests on to other
+   devices should use "none", so that requests are scheduled once,
+   by the device that serves them.  Returns false if there is no
+   such scheduler, or if NAME is "none" and BLOCK has queued
+   requests already.  A window's scheduler is never used. */
+bool
+block_set_scheduler (struct block *block, const char *name)
+{
+  const struct iosched *sched = iosched_find (name);
+  if (sched == NULL)
+    return false;
+
+  lock_acquire (&queue_lock);
+  bool ok = iosched_queues (sched) || block->queue == NULL;
+  if (ok)
+    {
+      if (block->queue != NULL)
+        block_queue_set_scheduler (block->queue, sched);
+      block->sched = sched;
+    }
+  lock_release (&queue_lock);
+  return ok;
+}
+
+/* Returns the name of BLOCK's I/O scheduler. */
+const char *
+block_scheduler (struct block *block)
+{
+  return iosched_name (block->sched);
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -160,6 +475,87 @@ block_type (struct block *block)
   return block->type;
 }
 
+/* Returns true if some window, such as a partition, lies on
+   BLOCK. */
+bool
+block_has_windows (struct block *block)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_blocks); e != list_end (&all_blocks);
+       e = list_next (e))
+    if (list_entry (e, struct block, list_elem)->target == block)
+      return true;
+  return false;
+}
+
+/* Copies BLOCK's statistics into *STATS. */
+void
+block_get_stats (struct block *block, struct block_stats *stats)
+{
+  enum intr_level old_level = intr_disable ();
+  *stats = block->stats;
+  intr_set_level (old_level);
+}
+
+/* Prints the nonzero buckets of HISTOGRAM, which has CNT buckets,
+   as " 2^N:COUNT" pairs. */
+static void
+print_histogram (const unsigned histogram[], int cnt)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    if (histogram[i] != 0)
+      printf (" 2^%d:%u", i, histogram[i]);
+}
+
+/* Prints BLOCK's statistics: sectors read and written, then, if
+   it has been used, its request counts and bytes moved, its
+   average queue and service times in CPU cycles and their
+   histograms, its histogram of request sizes in sectors, and how
+   often each number of requests was already in flight when a new
+   one arrived. */
+static void
+print_stats (struct block *block)
+{
+  struct block_stats s;
+  unsigned long long reqs;
+  int i;
+
+  block_get_stats (block, &s);
+  printf ("%s (%s): %llu reads, %llu writes\n",
+          block->name, block_type_name (block->type),
+          s.read_cnt, s.write_cnt);
+
+  reqs = s.read_reqs + s.write_reqs;
+  if (reqs == 0)
+    return;
+  printf ("  requests: %llu reads, %llu writes, "
+          "%llu bytes read, %llu bytes written\n",
+          s.read_reqs, s.write_reqs, s.read_cnt * BLOCK_SECTOR_SIZE,
+          s.write_cnt * BLOCK_SECTOR_SIZE);
+
+  reqs -= s.in_flight;
+  if (reqs > 0)
+    {
+      printf ("  queue: %llu cycles avg,", s.queue_cycles / reqs);
+      print_histogram (s.queue_latency, BLOCK_LATENCY_BUCKETS);
+      printf ("\n  service: %llu cycles avg,", s.service_cycles / reqs);
+      print_histogram (s.service_latency, BLOCK_LATENCY_BUCKETS);
+      printf ("\n");
+    }
+
+  printf ("  size:");
+  print_histogram (s.size, BLOCK_SIZE_BUCKETS);
+  printf ("\n  depth:");
+  for (i = 0; i < BLOCK_DEPTH_BUCKETS; i++)
+    if (s.depth[i] != 0)
+      printf (" %d%s:%u", i, i == BLOCK_DEPTH_BUCKETS - 1 ? "+" : "",
+              s.depth[i]);
+  printf ("\n");
+}
+
 /* Prints statistics for each block device used for a Pintos role. */
 void
 block_print_stats (void)
@@ -170,11 +566,7 @@ block_print_stats (void)
     {
       struct block *block = block_by_role[i];
       if (block != NULL)
-        {
-          printf ("%s (%s): %llu reads, %llu writes\n",
-                  block->name, block_type_name (block->type),
-                  block->read_cnt, block->write_cnt);
-        }
+        print_stats (block);
     }
 }
 
@@ -188,7 +580,16 @@ block_register (const char *name, enum block_type type,
                 const char *extra_info, block_sector_t size,
                 const struct block_operations *ops, void *aux)
 {
-  struct block *block = malloc (sizeof *block);
+  static bool queue_lock_initialized;
+  struct block *block;
+
+  if (!queue_lock_initialized)
+    {
+      lock_init (&queue_lock);
+      queue_lock_initialized = true;
+    }
+
+  block = malloc (sizeof *block);
   if (block == NULL)
     PANIC ("Failed to allocate memory for block device descriptor");
 
@@ -198,8 +599,11 @@ block_register (const char *name, enum block_type type,
   block->size = size;
   block->ops = ops;
   block->aux = aux;
-  block->read_cnt = 0;
-  block->write_cnt = 0;
+  block->target = NULL;
+  block->start = 0;
+  block->sched = iosched_get_default ();
+  block->queue = NULL;
+  memset (&block->stats, 0, sizeof block->stats);
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -210,7 +614,25 @@ block_register (const char *name, enum block_type type,
 
   return block;
 }
-
+
+/* Registers a new block device with the given NAME, TYPE, and
+   SIZE in sectors, as block_register(), that is a window onto
+   the SIZE sectors of TARGET starting at START, such as a
+   partition.  Requests to the window are remapped and queued on
+   TARGET. */
+struct block *
+block_register_window (const char *name, enum block_type type,
+                       const char *extra_info, block_sector_t size,
+                       struct block *target, block_sector_t start)
+{
+  struct block *block = block_register (name, type, extra_info, size,
+                                        NULL, NULL);
+  ASSERT (start <= target->size && size <= target->size - start);
+  block->target = target;
+  block->start = start;
+  return block;
+}
+
 /* Returns the block device corresponding to LIST_ELEM, or a null
    pointer if LIST_ELEM is the list end of all_blocks. */
 static struct block *
@@ -1,8 +1,11 @@
 #ifndef DEVICES_BLOCK_H
 #define DEVICES_BLOCK_H
 
+#include <list.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <inttypes.h>
+#include "threads/synch.h"
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -53,10 +56,85 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, size_t cnt,
+                          void *);
+void block_write_multiple (struct block *, block_sector_t, size_t cnt,
+                           const void *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
+bool block_has_windows (struct block *);
+
+/* Asynchronous requests. */
+struct block_request;
+typedef void block_complete_func (struct block_request *);
+
+/* A request to transfer CNT consecutive sectors between a block
+   device and BUFFER. */
+struct block_request
+  {
+    block_sector_t sector;      /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+    void *buffer;               /* CNT * BLOCK_SECTOR_SIZE bytes. */
+    bool write;                 /* To the device, or from it? */
+    block_complete_func *complete; /* Called when done, or null. */
+    void *aux;                  /* For COMPLETE's use. */
+
+    /* Owned by the block layer. */
+    struct block *block;        /* Device submitted to. */
+    uint64_t submit_time;       /* CPU cycle count when submitted... */
+    uint64_t dispatch_time;     /* ...and when passed to the driver. */
+    block_sector_t dev_sector;  /* First sector on the device serving it. */
+    struct list_elem sorted_elem; /* Element in queue, by sector. */
+    struct list_elem fifo_elem; /* Element in queue, by arrival. */
+    int64_t deadline;           /* Tick by which to dispatch. */
+    bool done;                  /* Transfer over? */
+    struct semaphore done_sema; /* Up'd when the transfer is over. */
+  };
+
+void block_request_init (struct block_request *, block_sector_t, size_t cnt,
+                         void *buffer, bool write,
+                         block_complete_func *, void *aux);
+void block_submit (struct block *, struct block_request *);
+void block_wait (struct block_request *);
+bool block_request_done (const struct block_request *);
+
+/* I/O scheduling. */
+bool block_set_scheduler (struct block *, const char *name);
+const char *block_scheduler (struct block *);
 
 /* Statistics. */
+
+/* Number of buckets in each histogram below.  Bucket I of a
+   latency or size histogram counts values from 2**I to
+   2**(I+1) - 1; bucket I of the depth histogram counts requests
+   that found I others in flight.  The last bucket also counts
+   everything beyond it. */
+#define BLOCK_LATENCY_BUCKETS 32
+#define BLOCK_SIZE_BUCKETS 16
+#define BLOCK_DEPTH_BUCKETS 16
+
+/* A block device's statistics.  A window's requests count both
+   for it and for the devices under it. */
+struct block_stats
+  {
+    unsigned long long read_cnt;        /* Number of sectors read. */
+    unsigned long long write_cnt;       /* Number of sectors written. */
+    unsigned long long read_reqs;       /* Number of read requests. */
+    unsigned long long write_reqs;      /* Number of write requests. */
+    unsigned in_flight;                 /* Requests submitted, not done. */
+
+    /* Totals and histograms, in CPU cycles, of the time completed
+       requests spent queued and then being carried out. */
+    unsigned long long queue_cycles;
+    unsigned long long service_cycles;
+    unsigned queue_latency[BLOCK_LATENCY_BUCKETS];
+    unsigned service_latency[BLOCK_LATENCY_BUCKETS];
+
+    unsigned size[BLOCK_SIZE_BUCKETS];  /* Sectors per request. */
+    unsigned depth[BLOCK_DEPTH_BUCKETS]; /* In flight at submission. */
+  };
+
+void block_get_stats (struct block *, struct block_stats *);
 void block_print_stats (void);
 
 /* Lower-level interface to block device drivers. */
@@ -65,10 +143,29 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Transfer CNT consecutive sectors at once.  Optional: if
+       null, the block layer calls read or write per sector. */
+    void (*read_multiple) (void *aux, block_sector_t, size_t cnt,
+                           void *buffer);
+    void (*write_multiple) (void *aux, block_sector_t, size_t cnt,
+                            const void *buffer);
+
+    /* Start REQ, which covers REQ->cnt sectors from REQ->dev_sector,
+       and return, usually before it is over.  Optional: if
+       non-null, the block layer hands every request here instead
+       of to the device's I/O scheduler, and the driver ends each
+       one with block_complete(). */
+    void (*submit) (void *aux, struct block_request *req);
   };
 
 struct block *block_register (const char *name, enum block_type,
                               const char *extra_info, block_sector_t size,
                               const struct block_operations *, void *aux);
+struct block *block_register_window (const char *name, enum block_type,
+                                     const char *extra_info,
+                                     block_sector_t size,
+                                     struct block *target,
+                                     block_sector_t start);
 
 #endif /* devices/block.h */
@@ -5,10 +5,14 @@
 #include <stdio.h>
 #include "devices/block.h"
 #include "devices/partition.h"
+#include "devices/pci.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -30,10 +34,26 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus master IDE port addresses, relative to the channel's
+   share of the controller's bus master ports.  See [SFF-8038i]. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table. */
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
+#define STA_DF 0x20             /* Device Fault. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
+
+/* Bus master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer from disk to memory. */
+
+/* Bus master Status Register bits. */
+#define BM_STA_ERR 0x02         /* Transfer failed. */
+#define BM_STA_INT 0x04         /* Disk raised its interrupt. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,8 +67,31 @@
    Many more are defined but this is the small subset that we
    use. */
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
-#define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
-#define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR(S) with retries. */
+#define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR(S) with retries. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* IDENTIFY DEVICE word 49, capabilities, bit for DMA support. */
+#define ID_CAP_DMA 0x0100
+
+/* A physical region descriptor, one entry in the table of memory
+   regions that the bus master transfers to or from.  A region
+   must not cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Size in bytes, 0 meaning 64 kB. */
+    uint16_t flags;             /* PRD_EOT on the last entry. */
+  };
+
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* Largest number of entries in a PRD table, which fills a page. */
+#define PRD_CNT (PGSIZE / sizeof (struct prd))
+
+/* Use PIO even if the disks support DMA? */
+bool ide_pio_only;
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +100,7 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    bool dma;                   /* Transfer by bus master DMA? */
   };
 
 /* An ATA channel (aka controller).
@@ -72,6 +116,9 @@ struct channel
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+    uint16_t bm_base;           /* Bus master base port, 0 if none. */
+    struct prd *prdt;           /* PRD table, a page, if BM_BASE. */
+
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
 
@@ -85,10 +132,14 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void dma_init (void);
+
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
+static bool dma_transfer (struct ata_disk *, block_sector_t, size_t cnt,
+                          void *buffer, bool write);
 
 static void wait_until_idle (const struct ata_disk *);
 static bool wait_while_busy (const struct ata_disk *);
@@ -103,6 +154,9 @@ ide_init (void)
 {
   size_t chan_no;
 
+  if (!ide_pio_only)
+    dma_init ();
+
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
     {
       struct channel *c = &channels[chan_no];
@@ -136,6 +190,7 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->dma = false;
         }
 
       /* Register interrupt handler. */
@@ -155,6 +210,36 @@ ide_init (void)
     }
 }
 
+/* Looks for a PCI IDE controller capable of bus master DMA, such
+   as the PIIX that QEMU emulates, and sets up each channel to use
+   its half of the bus master ports.  Channels are left without
+   DMA if there is no such controller or memory is short. */
+static void
+dma_init (void)
+{
+  struct pci_dev pci;
+  uint32_t bar4;
+  size_t chan_no;
+
+  if (!pci_find_class (0x01, 0x01, &pci)
+      || !(pci_read_config (&pci, PCI_REG_CLASS) & 0x8000))
+    return;
+
+  /* BAR4 holds the bus master ports, 8 per channel. */
+  bar4 = pci_read_config (&pci, PCI_REG_BAR0 + 4 * 4);
+  if (!(bar4 & 1) || (bar4 & 0xfffc) == 0)
+    return;
+  pci_enable_master (&pci);
+
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    {
+      struct channel *c = &channels[chan_no];
+      c->prdt = palloc_get_page (0);
+      if (c->prdt != NULL)
+        c->bm_base = (bar4 & 0xfffc) + chan_no * 8;
+    }
+}
+
 /* Disk detection and identification. */
 
 static char *descramble_ata_string (char *, int size);
@@ -286,8 +371,10 @@ identify_ata_device (struct ata_disk *d)
   capacity = *(uint32_t *) &id[60 * 2];
   model = descramble_ata_string (&id[10 * 2], 20);
   serial = descramble_ata_string (&id[27 * 2], 40);
+  d->dma = c->bm_base != 0 && (*(uint16_t *) &id[49 * 2] & ID_CAP_DMA);
   snprintf (extra_info, sizeof extra_info,
-            "model \"%s\", serial \"%s\"", model, serial);
+            "model \"%s\", serial \"%s\"%s", model, serial,
+            d->dma ? ", DMA" : "");
 
   /* Disable access to IDE disks over 1 GB, which are likely
      physical IDE disks rather than virtual ones.  If we don't
@@ -337,63 +424,130 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
+/* Largest number of sectors one ATA command can transfer. */
+#define IDE_MAX_SECTORS 256
+
+/* Reads CNT sectors starting at SEC_NO from disk D into BUFFER,
+   which must have room for CNT * BLOCK_SECTOR_SIZE bytes, using
+   one command per IDE_MAX_SECTORS sectors.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_read_multiple (void *d_, block_sector_t sec_no, size_t cnt, void *buffer)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  uint8_t *p = buffer;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
+  while (cnt > 0)
+    {
+      size_t n = cnt < IDE_MAX_SECTORS ? cnt : IDE_MAX_SECTORS;
+      if (!dma_transfer (d, sec_no, n, p, false))
+        {
+          size_t i;
+
+          /* The disk interrupts once per sector in PIO mode. */
+          select_sector (d, sec_no, n);
+          issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+          for (i = 0; i < n; i++)
+            {
+              sema_down (&c->completion_wait);
+              if (!wait_while_busy (d))
+                PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                       d->name, sec_no + i);
+              input_sector (c, p + i * BLOCK_SECTOR_SIZE);
+            }
+        }
+      sec_no += n;
+      p += n * BLOCK_SECTOR_SIZE;
+      cnt -= n;
+    }
   lock_release (&c->lock);
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
+/* Write CNT sectors starting at SEC_NO to disk D from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes, using one
+   command per IDE_MAX_SECTORS sectors.  Returns after the disk
+   has acknowledged receiving the data.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+ide_write_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                    const void *buffer)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  const uint8_t *p = buffer;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
+  while (cnt > 0)
+    {
+      size_t n = cnt < IDE_MAX_SECTORS ? cnt : IDE_MAX_SECTORS;
+      if (!dma_transfer (d, sec_no, n, (void *) p, true))
+        {
+          size_t i;
+
+          /* The disk asks for each sector with DRQ and interrupts
+             once it has taken it. */
+          select_sector (d, sec_no, n);
+          issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+          for (i = 0; i < n; i++)
+            {
+              if (!wait_while_busy (d))
+                PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                       d->name, sec_no + i);
+              output_sector (c, p + i * BLOCK_SECTOR_SIZE);
+              sema_down (&c->completion_wait);
+            }
+        }
+      sec_no += n;
+      p += n * BLOCK_SECTOR_SIZE;
+      cnt -= n;
+    }
   lock_release (&c->lock);
 }
 
+/* Reads sector SEC_NO from disk D into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes. */
+static void
+ide_read (void *d, block_sector_t sec_no, void *buffer)
+{
+  ide_read_multiple (d, sec_no, 1, buffer);
+}
+
+/* Write sector SEC_NO to disk D from BUFFER, which must contain
+   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data. */
+static void
+ide_write (void *d, block_sector_t sec_no, const void *buffer)
+{
+  ide_write_multiple (d, sec_no, 1, buffer);
+}
+
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple,
+    NULL
   };
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the count CNT of sectors to transfer, at most
+   256, to the disk's sector selection registers.  (We use LBA
+   mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= 256);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -430,6 +584,105 @@ output_sector (struct channel *c, const void *sector)
   outsw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
 }
 
+/* Fills channel C's PRD table to describe the SIZE bytes of
+   kernel memory at BUFFER, merging physically contiguous pages
+   and splitting regions at 64 kB boundaries.  Returns false if
+   the table is too small or BUFFER is not word aligned. */
+static bool
+build_prdt (struct channel *c, const void *buffer, size_t size)
+{
+  const uint8_t *p = buffer;
+  size_t n = 0;
+
+  if ((uintptr_t) buffer & 1)
+    return false;
+
+  while (size > 0)
+    {
+      uintptr_t addr = kernel_vtop (p);
+      size_t chunk = PGSIZE - pg_ofs (p);
+      if (chunk > size)
+        chunk = size;
+
+      /* Extend the previous region if this one follows it in
+         physical memory and stays within its 64 kB. */
+      if (n > 0)
+        {
+          struct prd *last = &c->prdt[n - 1];
+          size_t last_size = last->size != 0 ? last->size : 0x10000;
+          if (last->addr + last_size == addr
+              && (last->addr >> 16) == ((addr + chunk - 1) >> 16))
+            {
+              last->size = last_size + chunk;
+              p += chunk;
+              size -= chunk;
+              continue;
+            }
+        }
+
+      if (n >= PRD_CNT)
+        return false;
+      c->prdt[n].addr = addr;
+      c->prdt[n].size = chunk;
+      c->prdt[n].flags = 0;
+      n++;
+      p += chunk;
+      size -= chunk;
+    }
+
+  ASSERT (n > 0);
+  c->prdt[n - 1].flags = PRD_EOT;
+  return true;
+}
+
+/* Transfers CNT sectors starting at SEC_NO between disk D and
+   BUFFER by bus master DMA, into BUFFER if WRITE is false and out
+   of it if WRITE is true.  The CPU is free for other threads
+   until the disk interrupts at the end.  D's channel lock must be
+   held.
+
+   Returns false without touching the disk if D does not do DMA
+   or BUFFER cannot be described to the bus master, so that the
+   caller can use PIO instead.  If the transfer itself fails, also
+   turns DMA off for D, with a message, and returns false. */
+static bool
+dma_transfer (struct ata_disk *d, block_sector_t sec_no, size_t cnt,
+              void *buffer, bool write)
+{
+  struct channel *c = d->channel;
+  uint8_t bm_status, status;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  if (!d->dma || !build_prdt (c, buffer, cnt * BLOCK_SECTOR_SIZE))
+    return false;
+
+  /* Program the bus master, clearing stale status bits, which are
+     cleared by writing 1-bits. */
+  outl (reg_bm_prdt (c), vtop (c->prdt));
+  outb (reg_bm_command (c), write ? 0 : BM_CMD_READ);
+  outb (reg_bm_status (c), BM_STA_ERR | BM_STA_INT);
+
+  /* Issue the command to the disk, then start the bus master. */
+  select_sector (d, sec_no, cnt);
+  issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (reg_bm_command (c), inb (reg_bm_command (c)) | BM_CMD_START);
+  sema_down (&c->completion_wait);
+  outb (reg_bm_command (c), inb (reg_bm_command (c)) & ~BM_CMD_START);
+
+  bm_status = inb (reg_bm_status (c));
+  status = inb (reg_alt_status (c));
+  outb (reg_bm_status (c), BM_STA_ERR | BM_STA_INT);
+  if ((bm_status & BM_STA_ERR) || (status & (STA_BSY | STA_DF | STA_ERR)))
+    {
+      printf ("%s: DMA %s failed, sector=%"PRDSNu", using PIO\n",
+              d->name, write ? "write" : "read", sec_no);
+      d->dma = false;
+      return false;
+    }
+  return true;
+}
+
 /* Low-level ATA primitives. */
 
 /* Wait up to 10 seconds for the controller to become idle, that
@@ -0,0 +1,376 @@
+#include "devices/iosched.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* The code in this file keeps a queue of pending requests for
+   each block device that has an I/O scheduler, and runs a
+   dispatch thread per queue that hands the requests to the
+   driver one batch at a time.  The scheduler picks the request
+   to dispatch next; the queue then merges into the batch any
+   queued requests in the same direction for the sectors just
+   before or after it. */
+
+/* Pages in a queue's merge buffer, and the most sectors merged
+   into one batch. */
+#define MERGE_PAGES 8
+#define MERGE_SECTORS (MERGE_PAGES * PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Ticks a read or a write may wait in the deadline scheduler
+   before it is dispatched ahead of the elevator order. */
+#define READ_EXPIRE (TIMER_FREQ / 2)
+#define WRITE_EXPIRE (5 * TIMER_FREQ)
+
+/* An I/O scheduler. */
+struct iosched
+  {
+    const char *name;           /* Name, for the -iosched option. */
+
+    /* Returns the queued request to dispatch next, without
+       removing it.  The queue is not empty.  Null for "none",
+       which has no queue: requests go to the driver at once, in
+       the submitting thread. */
+    struct block_request *(*pick) (struct block_queue *);
+  };
+
+/* A block device's queue of pending requests. */
+struct block_queue
+  {
+    struct block *block;        /* Device served. */
+    const struct iosched *sched; /* Scheduler in use. */
+
+    struct lock lock;           /* Protects the members below. */
+    struct condition ready;     /* Signaled when a request arrives. */
+    struct list sorted;         /* Queued requests, by sector. */
+    struct list fifo;           /* Queued requests, by arrival. */
+    block_sector_t head;        /* Sector after the last dispatched. */
+    uint8_t *merge_buffer;      /* MERGE_SECTORS sectors, or null. */
+  };
+
+static struct block_request *pick_fifo (struct block_queue *);
+static struct block_request *pick_clook (struct block_queue *);
+static struct block_request *pick_deadline (struct block_queue *);
+
+/* Known schedulers. */
+static const struct iosched schedulers[] =
+  {
+    {"none", NULL},             /* No queue. */
+    {"noop", pick_fifo},        /* Arrival order, with merging. */
+    {"clook", pick_clook},      /* Circular elevator. */
+    {"deadline", pick_deadline}, /* Elevator, but bounding waits. */
+  };
+#define SCHEDULER_CNT (sizeof schedulers / sizeof *schedulers)
+
+/* Scheduler of newly registered block devices.
+   Set by the kernel command-line option "-iosched". */
+static const struct iosched *default_sched = &schedulers[3];
+
+static thread_func dispatch_thread NO_RETURN;
+
+/* Returns the scheduler called NAME, or a null pointer if there
+   is none. */
+const struct iosched *
+iosched_find (const char *name)
+{
+  size_t i;
+
+  if (name != NULL)
+    for (i = 0; i < SCHEDULER_CNT; i++)
+      if (!strcmp (schedulers[i].name, name))
+        return &schedulers[i];
+  return NULL;
+}
+
+/* Returns the name of SCHED. */
+const char *
+iosched_name (const struct iosched *sched)
+{
+  return sched->name;
+}
+
+/* Returns true if devices using SCHED queue their requests. */
+bool
+iosched_queues (const struct iosched *sched)
+{
+  return sched->pick != NULL;
+}
+
+/* Makes the scheduler called NAME the one newly registered block
+   devices start with.  Returns false if there is no such
+   scheduler. */
+bool
+iosched_set_default (const char *name)
+{
+  const struct iosched *sched = iosched_find (name);
+  if (sched == NULL)
+    return false;
+  default_sched = sched;
+  return true;
+}
+
+/* Returns the scheduler newly registered block devices start
+   with. */
+const struct iosched *
+iosched_get_default (void)
+{
+  return default_sched;
+}
+
+/* Creates a request queue for BLOCK, scheduled by SCHED, and
+   starts its dispatch thread.  Panics if memory is short. */
+struct block_queue *
+block_queue_create (struct block *block, const struct iosched *sched)
+{
+  struct block_queue *q = malloc (sizeof *q);
+  char name[16];
+
+  if (q == NULL)
+    PANIC ("Failed to allocate memory for request queue");
+  q->block = block;
+  q->sched = sched;
+  lock_init (&q->lock);
+  cond_init (&q->ready);
+  list_init (&q->sorted);
+  list_init (&q->fifo);
+  q->head = 0;
+  q->merge_buffer = palloc_get_multiple (0, MERGE_PAGES);
+
+  snprintf (name, sizeof name, "io-%s", block_name (block));
+  if (thread_create (name, PRI_DEFAULT, dispatch_thread, q) == TID_ERROR)
+    PANIC ("Failed to start dispatch thread for %s", block_name (block));
+  return q;
+}
+
+/* Makes Q's later dispatches follow SCHED, which must queue. */
+void
+block_queue_set_scheduler (struct block_queue *q,
+                           const struct iosched *sched)
+{
+  ASSERT (iosched_queues (sched));
+
+  lock_acquire (&q->lock);
+  q->sched = sched;
+  lock_release (&q->lock);
+}
+
+/* Returns true if request A's first sector precedes request B's. */
+static bool
+sector_less (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED)
+{
+  const struct block_request *a
+      = list_entry (a_, struct block_request, sorted_elem);
+  const struct block_request *b
+      = list_entry (b_, struct block_request, sorted_elem);
+  return a->dev_sector < b->dev_sector;
+}
+
+/* Queues REQ on Q and returns.  Q's dispatch thread completes REQ
+   with block_complete() once it has been carried out. */
+void
+block_queue_submit (struct block_queue *q, struct block_request *req)
+{
+  req->deadline = timer_ticks () + (req->write ? WRITE_EXPIRE : READ_EXPIRE);
+
+  lock_acquire (&q->lock);
+  list_insert_ordered (&q->sorted, &req->sorted_elem, sector_less, NULL);
+  list_push_back (&q->fifo, &req->fifo_elem);
+  cond_signal (&q->ready, &q->lock);
+  lock_release (&q->lock);
+}
+
+/* Scheduler "noop": the oldest request. */
+static struct block_request *
+pick_fifo (struct block_queue *q)
+{
+  return list_entry (list_front (&q->fifo), struct block_request, fifo_elem);
+}
+
+/* Scheduler "clook": the lowest request at or past the sector
+   after the last one dispatched, sweeping the disk in one
+   direction and jumping back to the lowest request at the end. */
+static struct block_request *
+pick_clook (struct block_queue *q)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&q->sorted); e != list_end (&q->sorted);
+       e = list_next (e))
+    {
+      struct block_request *r
+          = list_entry (e, struct block_request, sorted_elem);
+      if (r->dev_sector >= q->head)
+        return r;
+    }
+  return list_entry (list_front (&q->sorted), struct block_request,
+                     sorted_elem);
+}
+
+/* Scheduler "deadline": the oldest read, then the oldest write,
+   if it has waited past its deadline, otherwise as "clook".
+   Deadlines grow with arrival order within each direction, so
+   the first of each in the FIFO is the one to check. */
+static struct block_request *
+pick_deadline (struct block_queue *q)
+{
+  struct block_request *read = NULL, *write = NULL;
+  int64_t now = timer_ticks ();
+  struct list_elem *e;
+
+  for (e = list_begin (&q->fifo);
+       e != list_end (&q->fifo) && (read == NULL || write == NULL);
+       e = list_next (e))
+    {
+      struct block_request *r
+          = list_entry (e, struct block_request, fifo_elem);
+      if (r->write && write == NULL)
+        write = r;
+      else if (!r->write && read == NULL)
+        read = r;
+    }
+
+  if (read != NULL && read->deadline <= now)
+    return read;
+  if (write != NULL && write->deadline <= now)
+    return write;
+  return pick_clook (q);
+}
+
+/* Removes REQ from its queue and appends it to BATCH, or
+   prepends it if FRONT is true. */
+static void
+take_request (struct block_request *req, struct list *batch, bool front)
+{
+  list_remove (&req->sorted_elem);
+  list_remove (&req->fifo_elem);
+  if (front)
+    list_push_front (batch, &req->sorted_elem);
+  else
+    list_push_back (batch, &req->sorted_elem);
+}
+
+/* Removes the request Q's scheduler picks from Q, together with
+   the queued requests it can be merged with, and puts them in
+   BATCH in sector order.  Stores the batch's first sector and
+   sector count in *SECTOR and *CNT. */
+static void
+take_batch (struct block_queue *q, struct list *batch,
+            block_sector_t *sector, size_t *cnt)
+{
+  struct block_request *req = q->sched->pick (q);
+  struct list_elem *prev = list_prev (&req->sorted_elem);
+  struct list_elem *next = list_next (&req->sorted_elem);
+
+  *sector = req->dev_sector;
+  *cnt = req->cnt;
+  take_request (req, batch, false);
+
+  if (q->merge_buffer == NULL)
+    return;
+
+  /* Merge requests that continue the batch. */
+  while (next != list_end (&q->sorted))
+    {
+      struct block_request *r
+          = list_entry (next, struct block_request, sorted_elem);
+      if (r->write != req->write || r->dev_sector != *sector + *cnt
+          || *cnt + r->cnt > MERGE_SECTORS)
+        break;
+      next = list_next (next);
+      *cnt += r->cnt;
+      take_request (r, batch, false);
+    }
+
+  /* Merge requests that lead up to it. */
+  while (prev != list_head (&q->sorted))
+    {
+      struct block_request *r
+          = list_entry (prev, struct block_request, sorted_elem);
+      if (r->write != req->write || r->dev_sector + r->cnt != *sector
+          || *cnt + r->cnt > MERGE_SECTORS)
+        break;
+      prev = list_prev (prev);
+      *sector = r->dev_sector;
+      *cnt += r->cnt;
+      take_request (r, batch, true);
+    }
+}
+
+/* Dispatch thread for queue Q_: hands Q_'s requests to the driver
+   a batch at a time, forever. */
+static void
+dispatch_thread (void *q_)
+{
+  struct block_queue *q = q_;
+
+  for (;;)
+    {
+      struct list batch;
+      struct block_request *first;
+      struct list_elem *e;
+      block_sector_t sector;
+      size_t cnt;
+      uint64_t now;
+
+      lock_acquire (&q->lock);
+      while (list_empty (&q->fifo))
+        cond_wait (&q->ready, &q->lock);
+      list_init (&batch);
+      take_batch (q, &batch, &sector, &cnt);
+      q->head = sector + cnt;
+      lock_release (&q->lock);
+
+      now = rdtsc ();
+      for (e = list_begin (&batch); e != list_end (&batch); e = list_next (e))
+        list_entry (e, struct block_request, sorted_elem)->dispatch_time = now;
+
+      first = list_entry (list_front (&batch), struct block_request,
+                          sorted_elem);
+      if (list_next (&first->sorted_elem) == list_end (&batch))
+        block_driver_io (q->block, sector, cnt, first->buffer, first->write);
+      else
+        {
+          /* Move a merged batch through the merge buffer, which
+             only this thread uses. */
+          if (first->write)
+            for (e = list_begin (&batch); e != list_end (&batch);
+                 e = list_next (e))
+              {
+                struct block_request *r
+                    = list_entry (e, struct block_request, sorted_elem);
+                memcpy (q->merge_buffer
+                        + (r->dev_sector - sector) * BLOCK_SECTOR_SIZE,
+                        r->buffer, r->cnt * BLOCK_SECTOR_SIZE);
+              }
+
+          block_driver_io (q->block, sector, cnt, q->merge_buffer,
+                           first->write);
+
+          if (!first->write)
+            for (e = list_begin (&batch); e != list_end (&batch);
+                 e = list_next (e))
+              {
+                struct block_request *r
+                    = list_entry (e, struct block_request, sorted_elem);
+                memcpy (r->buffer,
+                        q->merge_buffer
+                        + (r->dev_sector - sector) * BLOCK_SECTOR_SIZE,
+                        r->cnt * BLOCK_SECTOR_SIZE);
+              }
+        }
+
+      while (!list_empty (&batch))
+        {
+          struct block_request *r = list_entry (list_pop_front (&batch),
+                                                struct block_request,
+                                                sorted_elem);
+          block_complete (r);
+        }
+    }
+}
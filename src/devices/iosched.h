@@ -0,0 +1,30 @@
+#ifndef DEVICES_IOSCHED_H
+#define DEVICES_IOSCHED_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* An I/O scheduler. */
+struct iosched;
+
+/* Choosing schedulers. */
+const struct iosched *iosched_find (const char *name);
+const char *iosched_name (const struct iosched *);
+bool iosched_queues (const struct iosched *);
+bool iosched_set_default (const char *name);
+const struct iosched *iosched_get_default (void);
+
+/* Request queues. */
+struct block_queue *block_queue_create (struct block *,
+                                        const struct iosched *);
+void block_queue_set_scheduler (struct block_queue *, const struct iosched *);
+void block_queue_submit (struct block_queue *, struct block_request *);
+
+/* Passes a transfer to BLOCK's driver, bypassing its queue, and
+   ends a request.  Defined in devices/block.c. */
+void block_driver_io (struct block *, block_sector_t, size_t cnt,
+                      void *buffer, bool write);
+void block_complete (struct block_request *);
+
+#endif /* devices/iosched.h */
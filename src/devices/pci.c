@@ -0,0 +1,129 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include "threads/io.h"
+
+/* The code in this file accesses PCI configuration space through
+   configuration mechanism #1, the pair of I/O ports that every PC
+   chipset since the original PCI ones provides.  See [PCI]. */
+
+/* I/O port addresses. */
+#define PCI_CONFIG_ADDRESS 0xcf8 /* Selects a configuration register. */
+#define PCI_CONFIG_DATA 0xcfc    /* Data of the selected register. */
+
+/* CONFIG_ADDRESS bit that enables the configuration cycle. */
+#define PCI_CONFIG_ENABLE 0x80000000
+
+/* Header type bit set for devices with more than one function. */
+#define PCI_HEADER_MULTI 0x80
+
+/* Selects register REG, which must be 32-bit aligned, of PCI
+   function D. */
+static void
+select_register (const struct pci_dev *d, uint8_t reg)
+{
+  ASSERT (reg % 4 == 0);
+  outl (PCI_CONFIG_ADDRESS, PCI_CONFIG_ENABLE | (d->bus << 16)
+                            | (d->dev << 11) | (d->func << 8) | reg);
+}
+
+/* Returns the 32-bit configuration register REG of PCI function
+   D.  Reading the ID register of a function that does not exist
+   returns all 1-bits. */
+uint32_t
+pci_read_config (const struct pci_dev *d, uint8_t reg)
+{
+  select_register (d, reg);
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Writes VALUE to the 32-bit configuration register REG of PCI
+   function D. */
+void
+pci_write_config (const struct pci_dev *d, uint8_t reg, uint32_t value)
+{
+  select_register (d, reg);
+  outl (PCI_CONFIG_DATA, value);
+}
+
+/* Scans the PCI buses, calling FUNC with the position of each
+   function present and AUX, until FUNC returns true.  Returns
+   true if FUNC did, false if the scan ran to the end. */
+bool
+pci_scan (pci_scan_func *func, void *aux)
+{
+  unsigned bus, dev, func_no;
+
+  for (bus = 0; bus < 256; bus++)
+    for (dev = 0; dev < 32; dev++)
+      for (func_no = 0; func_no < 8; func_no++)
+        {
+          struct pci_dev d;
+
+          d.bus = bus;
+          d.dev = dev;
+          d.func = func_no;
+          if ((pci_read_config (&d, PCI_REG_ID) & 0xffff) == 0xffff)
+            {
+              if (func_no == 0)
+                break;
+              continue;
+            }
+
+          if (func (&d, aux))
+            return true;
+
+          /* Only multi-function devices have functions past 0. */
+          if (func_no == 0
+              && !((pci_read_config (&d, PCI_REG_HEADER) >> 16)
+                   & PCI_HEADER_MULTI))
+            break;
+        }
+  return false;
+}
+
+/* What pci_find_class() looks for, and where it puts the
+   result. */
+struct class_query
+  {
+    uint8_t class, subclass;
+    struct pci_dev *d;
+  };
+
+/* pci_scan() function for pci_find_class(). */
+static bool
+match_class (const struct pci_dev *d, void *q_)
+{
+  struct class_query *q = q_;
+  uint32_t class_reg = pci_read_config (d, PCI_REG_CLASS);
+
+  if ((class_reg >> 24) != q->class
+      || ((class_reg >> 16) & 0xff) != q->subclass)
+    return false;
+  *q->d = *d;
+  return true;
+}
+
+/* Scans the PCI buses for the first function of class CLASS and
+   subclass SUBCLASS.  If one is found, stores its position in *D
+   and returns true.  Otherwise, returns false. */
+bool
+pci_find_class (uint8_t class, uint8_t subclass, struct pci_dev *d)
+{
+  struct class_query q;
+
+  q.class = class;
+  q.subclass = subclass;
+  q.d = d;
+  return pci_scan (match_class, &q);
+}
+
+/* Lets PCI function D decode its I/O ports and master the bus.
+   The status half of the register is written as zeros, because
+   writing 1-bits there would clear them. */
+void
+pci_enable_master (const struct pci_dev *d)
+{
+  uint32_t command = pci_read_config (d, PCI_REG_COMMAND) & 0xffff;
+  pci_write_config (d, PCI_REG_COMMAND,
+                    command | PCI_CMD_IO | PCI_CMD_MASTER);
+}
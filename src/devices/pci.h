@@ -0,0 +1,38 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A PCI function, identified by its position on the bus. */
+struct pci_dev
+  {
+    uint8_t bus;                /* Bus number, 0...255. */
+    uint8_t dev;                /* Device number, 0...31. */
+    uint8_t func;               /* Function number, 0...7. */
+  };
+
+/* Configuration space registers, as offsets of 32-bit words. */
+#define PCI_REG_ID 0x00         /* Device ID 31:16, Vendor ID 15:0. */
+#define PCI_REG_COMMAND 0x04    /* Status 31:16, Command 15:0. */
+#define PCI_REG_CLASS 0x08      /* Class 31:24, Subclass 23:16,
+                                   Programming interface 15:8. */
+#define PCI_REG_HEADER 0x0c     /* Header type 23:16. */
+#define PCI_REG_BAR0 0x10       /* Base address registers 0...5. */
+#define PCI_REG_INTR 0x3c       /* Interrupt line 7:0. */
+
+/* Command register bits. */
+#define PCI_CMD_IO 0x0001       /* Respond to I/O space accesses. */
+#define PCI_CMD_MASTER 0x0004   /* May act as bus master. */
+
+/* Called by pci_scan() for each PCI function present.  Returns
+   true to stop the scan. */
+typedef bool pci_scan_func (const struct pci_dev *, void *aux);
+
+uint32_t pci_read_config (const struct pci_dev *, uint8_t reg);
+void pci_write_config (const struct pci_dev *, uint8_t reg, uint32_t);
+bool pci_scan (pci_scan_func *, void *aux);
+bool pci_find_class (uint8_t class, uint8_t subclass, struct pci_dev *);
+void pci_enable_master (const struct pci_dev *);
+
+#endif /* devices/pci.h */
@@ -0,0 +1,110 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
+
+/* The code in this file is a block device kept in kernel memory.
+   It has the speed of memory, so it is useful for measuring the
+   layers above the block device in isolation and for scratch
+   work, but its contents are lost at power off. */
+
+/* Contents of the RAM disk, RAMDISK_SIZE sectors. */
+static uint8_t *ramdisk;
+
+static struct block_operations ramdisk_operations;
+
+/* Creates a RAM disk named "ram0" of KB kilobytes, rounded down
+   to whole sectors, allocated with vmalloc() so that it does not
+   need contiguous physical memory.  If LOAD_NAME is non-null,
+   fills it with the start of the block device by that name.  Its
+   type is "raw"; give it a role with -filesys or -swap.  Does
+   nothing if KB is less than a sector. */
+void
+ramdisk_init (size_t kb, const char *load_name)
+{
+  block_sector_t size = kb * 1024 / BLOCK_SECTOR_SIZE;
+  struct block *block;
+
+  if (size == 0)
+    return;
+
+  ramdisk = vmalloc ((size_t) size * BLOCK_SECTOR_SIZE);
+  if (ramdisk == NULL)
+    PANIC ("Failed to allocate %zu kB for RAM disk", kb);
+
+  if (load_name != NULL)
+    {
+      struct block *src = block_get_by_name (load_name);
+      block_sector_t cnt, sector;
+
+      if (src == NULL)
+        PANIC ("No such block device \"%s\"", load_name);
+      cnt = block_size (src) < size ? block_size (src) : size;
+      for (sector = 0; sector < cnt; sector += PGSIZE / BLOCK_SECTOR_SIZE)
+        {
+          size_t chunk = cnt - sector;
+          if (chunk > PGSIZE / BLOCK_SECTOR_SIZE)
+            chunk = PGSIZE / BLOCK_SECTOR_SIZE;
+          block_read_multiple (src, sector, chunk,
+                               ramdisk + sector * BLOCK_SECTOR_SIZE);
+        }
+      memset (ramdisk + cnt * BLOCK_SECTOR_SIZE, 0,
+              (size - cnt) * BLOCK_SECTOR_SIZE);
+      printf ("ram0: loaded %'"PRDSNu" sectors from %s\n", cnt, load_name);
+    }
+  else
+    memset (ramdisk, 0, (size_t) size * BLOCK_SECTOR_SIZE);
+
+  block = block_register ("ram0", BLOCK_RAW, "RAM disk", size,
+                          &ramdisk_operations, NULL);
+
+  /* Transfers are memory copies, so a queue and a dispatch
+     thread would only add latency. */
+  block_set_scheduler (block, "none");
+}
+
+/* Reads the CNT sectors starting at SECTOR from the RAM disk into
+   BUFFER. */
+static void
+ramdisk_read_multiple (void *aux UNUSED, block_sector_t sector, size_t cnt,
+                       void *buffer)
+{
+  memcpy (buffer, ramdisk + sector * BLOCK_SECTOR_SIZE,
+          cnt * BLOCK_SECTOR_SIZE);
+}
+
+/* Writes the CNT sectors starting at SECTOR to the RAM disk from
+   BUFFER. */
+static void
+ramdisk_write_multiple (void *aux UNUSED, block_sector_t sector, size_t cnt,
+                        const void *buffer)
+{
+  memcpy (ramdisk + sector * BLOCK_SECTOR_SIZE, buffer,
+          cnt * BLOCK_SECTOR_SIZE);
+}
+
+/* Reads sector SECTOR from the RAM disk into BUFFER. */
+static void
+ramdisk_read (void *aux, block_sector_t sector, void *buffer)
+{
+  ramdisk_read_multiple (aux, sector, 1, buffer);
+}
+
+/* Writes sector SECTOR to the RAM disk from BUFFER. */
+static void
+ramdisk_write (void *aux, block_sector_t sector, const void *buffer)
+{
+  ramdisk_write_multiple (aux, sector, 1, buffer);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write,
+    ramdisk_read_multiple,
+    ramdisk_write_multiple,
+    NULL
+  };
@@ -0,0 +1,330 @@
+#include "devices/stripe.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/iosched.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+
+/* The code in this file is a block device that stripes its
+   sectors across several other block devices, its members, like
+   RAID level 0.  Sectors go to the members CHUNK at a time in
+   turn, so a large transfer keeps all of them busy at once.
+   There is no redundancy: losing one member loses the data.
+
+   A request to the stripe becomes a request to each chunk it
+   touches, all submitted at once, and is over when the last of
+   them is.  Each member schedules its share in its own queue, so
+   members on different IDE channels, or virtio disks, work in
+   parallel. */
+
+/* Most members of a stripe. */
+#define STRIPE_MAX_MEMBERS 4
+
+/* Most member requests in flight per stripe transfer.  They live
+   on the kernel stack. */
+#define STRIPE_BATCH STRIPE_MAX_MEMBERS
+
+/* A striped block device. */
+struct stripe
+  {
+    struct block *members[STRIPE_MAX_MEMBERS]; /* Member devices. */
+    size_t member_cnt;          /* Number of members. */
+    block_sector_t chunk;       /* Sectors per chunk. */
+  };
+
+static struct block_operations stripe_operations;
+
+/* The stripe created by stripe_init(), if any. */
+static struct stripe *the_stripe;
+
+/* Returns true if BLOCK is one of stripe S's members. */
+static bool
+is_member (const struct stripe *s, struct block *block)
+{
+  size_t i;
+
+  for (i = 0; i < s->member_cnt; i++)
+    if (s->members[i] == block)
+      return true;
+  return false;
+}
+
+/* Returns true if BLOCK plays a Pintos role already, or is a
+   partition made for one, so that the stripe must not take it
+   over. */
+static bool
+has_role (struct block *block)
+{
+  enum block_type role;
+
+  if (block_type (block) < BLOCK_ROLE_CNT)
+    return true;
+  for (role = 0; role < BLOCK_ROLE_CNT; role++)
+    if (block_get_role (role) == block)
+      return true;
+  return false;
+}
+
+/* Creates a block device "md0" that stripes across the block
+   devices named in NAMES, separated by commas, CHUNK sectors at
+   a time, and returns it.  Returns a null pointer if NAMES is
+   null.  Panics if a device does not exist, is named twice, has
+   a role or partitions of its own, or if there are too many. */
+struct block *
+stripe_init (const char *names, block_sector_t chunk)
+{
+  struct stripe *s;
+  struct block *block;
+  block_sector_t member_size = 0;
+  char copy[128], extra_info[128];
+  char *name, *save_ptr;
+  size_t i;
+
+  if (names == NULL)
+    return NULL;
+  if (chunk == 0)
+    PANIC ("stripe: chunk size must be at least 1 sector");
+
+  s = malloc (sizeof *s);
+  if (s == NULL)
+    PANIC ("Failed to allocate memory for stripe descriptor");
+  s->member_cnt = 0;
+  s->chunk = chunk;
+
+  strlcpy (copy, names, sizeof copy);
+  for (name = strtok_r (copy, ",", &save_ptr); name != NULL;
+       name = strtok_r (NULL, ",", &save_ptr))
+    {
+      struct block *member = block_get_by_name (name);
+      if (member == NULL)
+        PANIC ("No such block device \"%s\"", name);
+      if (is_member (s, member))
+        PANIC ("stripe: %s named twice", name);
+      if (has_role (member))
+        PANIC ("stripe: %s has a Pintos role", name);
+      if (block_has_windows (member))
+        PANIC ("stripe: %s has partitions", name);
+      if (s->member_cnt == STRIPE_MAX_MEMBERS)
+        PANIC ("stripe: more than %d members", STRIPE_MAX_MEMBERS);
+      if (s->member_cnt == 0 || block_size (member) < member_size)
+        member_size = block_size (member);
+      s->members[s->member_cnt++] = member;
+    }
+  if (s->member_cnt == 0)
+    PANIC ("stripe: no members");
+
+  /* Use whole chunks of the smallest member. */
+  member_size -= member_size % chunk;
+  if (member_size == 0)
+    PANIC ("stripe: members smaller than one chunk");
+
+  snprintf (extra_info, sizeof extra_info,
+            "stripe of %zu, %'"PRDSNu"-sector chunks:", s->member_cnt, chunk);
+  for (i = 0; i < s->member_cnt; i++)
+    {
+      size_t len = strlen (extra_info);
+      snprintf (extra_info + len, sizeof extra_info - len, " %s",
+                block_name (s->members[i]));
+    }
+
+  block = block_register ("md0", BLOCK_RAW, extra_info,
+                          member_size * s->member_cnt, &stripe_operations, s);
+
+  the_stripe = s;
+
+  /* The members schedule their own requests, and stripe_submit()
+     takes md0's without one.  A queue here would only add a
+     thread hop before them. */
+  block_set_scheduler (block, "none");
+  return block;
+}
+
+/* Returns true if BLOCK is a member of the stripe, whose
+   sectors belong to md0 and must not be used directly. */
+bool
+stripe_is_member (struct block *block)
+{
+  return the_stripe != NULL && is_member (the_stripe, block);
+}
+
+/* Returns the number of chunks of stripe S that the CNT sectors
+   starting at SECTOR touch. */
+static size_t
+chunk_cnt (const struct stripe *s, block_sector_t sector, size_t cnt)
+{
+  return (sector % s->chunk + cnt + s->chunk - 1) / s->chunk;
+}
+
+/* Initializes the first of the CNT sectors starting at SECTOR of
+   stripe S, up to the end of SECTOR's chunk, as REQ, a request
+   to transfer them between the right member and BUFFER, with
+   COMPLETE and AUX as block_request_init() describes.  Returns
+   the member, and stores the number of sectors in *PIECE. */
+static struct block *
+init_piece (const struct stripe *s, block_sector_t sector, size_t cnt,
+            uint8_t *buffer, bool write, struct block_request *req,
+            block_complete_func *complete, void *aux, size_t *piece)
+{
+  block_sector_t chunk_no = sector / s->chunk;
+  block_sector_t ofs = sector % s->chunk;
+  block_sector_t member_sector = chunk_no / s->member_cnt * s->chunk + ofs;
+
+  *piece = s->chunk - ofs < cnt ? s->chunk - ofs : cnt;
+  block_request_init (req, member_sector, *piece, buffer, write,
+                      complete, aux);
+  return s->members[chunk_no % s->member_cnt];
+}
+
+/* Moves CNT sectors starting at SECTOR between stripe S and
+   BUFFER, into BUFFER if WRITE is false and out of it if WRITE
+   is true.  Submits a request for each chunk touched, up to
+   STRIPE_BATCH at a time, then waits for them all. */
+static void
+stripe_transfer (struct stripe *s, block_sector_t sector, size_t cnt,
+                 uint8_t *buffer, bool write)
+{
+  while (cnt > 0)
+    {
+      struct block_request reqs[STRIPE_BATCH];
+      size_t n, i;
+
+      for (n = 0; n < STRIPE_BATCH && cnt > 0; n++)
+        {
+          size_t piece;
+          struct block *member = init_piece (s, sector, cnt, buffer, write,
+                                             &reqs[n], NULL, NULL, &piece);
+          block_submit (member, &reqs[n]);
+
+          sector += piece;
+          buffer += piece * BLOCK_SECTOR_SIZE;
+          cnt -= piece;
+        }
+
+      for (i = 0; i < n; i++)
+        block_wait (&reqs[i]);
+    }
+}
+
+/* A request to the stripe in flight, split into one request per
+   chunk. */
+struct stripe_io
+  {
+    struct block_request *parent;       /* Request to the stripe. */
+    size_t pending;                     /* Member requests not done. */
+    struct block_request reqs[];        /* Member requests. */
+  };
+
+/* Drops one of IO's pending counts.  Ends the request to the
+   stripe and frees IO if it was the last. */
+static void
+stripe_io_put (struct stripe_io *io)
+{
+  enum intr_level old_level;
+  bool last;
+
+  /* Members finish in their own dispatch threads. */
+  old_level = intr_disable ();
+  last = --io->pending == 0;
+  intr_set_level (old_level);
+
+  if (last)
+    {
+      block_complete (io->parent);
+      free (io);
+    }
+}
+
+/* Called when REQ, one of a stripe_io's member requests, is over. */
+static void
+member_complete (struct block_request *req)
+{
+  stripe_io_put (req->aux);
+}
+
+/* Starts REQ on stripe S_ by submitting a request for each chunk
+   it touches, and returns without waiting for them.  The last
+   one to finish ends REQ.  This keeps md0 from blocking its
+   submitter even though it has no queue of its own.  If memory
+   is short, carries REQ out at once instead. */
+static void
+stripe_submit (void *s_, struct block_request *req)
+{
+  struct stripe *s = s_;
+  block_sector_t sector = req->dev_sector;
+  size_t cnt = req->cnt;
+  uint8_t *buffer = req->buffer;
+  size_t n = chunk_cnt (s, sector, cnt);
+  struct stripe_io *io;
+  size_t i;
+
+  io = malloc (sizeof *io + n * sizeof *io->reqs);
+  if (io == NULL)
+    {
+      stripe_transfer (s, sector, cnt, buffer, req->write);
+      block_complete (req);
+      return;
+    }
+
+  /* Hold one extra count until every member request is
+     submitted, so that IO is not freed while in use here. */
+  io->parent = req;
+  io->pending = n + 1;
+  for (i = 0; i < n; i++)
+    {
+      size_t piece;
+      struct block *member = init_piece (s, sector, cnt, buffer, req->write,
+                                         &io->reqs[i], member_complete, io,
+                                         &piece);
+      block_submit (member, &io->reqs[i]);
+
+      sector += piece;
+      buffer += piece * BLOCK_SECTOR_SIZE;
+      cnt -= piece;
+    }
+  ASSERT (cnt == 0);
+  stripe_io_put (io);
+}
+
+/* Reads CNT sectors starting at SECTOR from stripe S_ into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes. */
+static void
+stripe_read_multiple (void *s_, block_sector_t sector, size_t cnt,
+                      void *buffer)
+{
+  stripe_transfer (s_, sector, cnt, buffer, false);
+}
+
+/* Writes CNT sectors starting at SECTOR to stripe S_ from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes.  Returns
+   after every member has acknowledged receiving its data. */
+static void
+stripe_write_multiple (void *s_, block_sector_t sector, size_t cnt,
+                       const void *buffer)
+{
+  stripe_transfer (s_, sector, cnt, (void *) buffer, true);
+}
+
+/* Reads sector SECTOR from stripe S_ into BUFFER. */
+static void
+stripe_read (void *s_, block_sector_t sector, void *buffer)
+{
+  stripe_transfer (s_, sector, 1, buffer, false);
+}
+
+/* Writes sector SECTOR to stripe S_ from BUFFER. */
+static void
+stripe_write (void *s_, block_sector_t sector, const void *buffer)
+{
+  stripe_transfer (s_, sector, 1, (void *) buffer, true);
+}
+
+static struct block_operations stripe_operations =
+  {
+    stripe_read,
+    stripe_write,
+    stripe_read_multiple,
+    stripe_write_multiple,
+    stripe_submit
+  };
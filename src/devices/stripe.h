@@ -0,0 +1,9 @@
+#ifndef DEVICES_STRIPE_H
+#define DEVICES_STRIPE_H
+
+#include "devices/block.h"
+
+struct block *stripe_init (const char *names, block_sector_t chunk);
+bool stripe_is_member (struct block *);
+
+#endif /* devices/stripe.h */
@@ -0,0 +1,418 @@
+#include "devices/virtio.h"
+#include <debug.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "devices/partition.h"
+#include "devices/pci.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
+
+/* The code in this file drives virtio block devices, such as
+   the ones QEMU provides with "-drive if=virtio", through the
+   legacy virtio PCI interface.  See [VIRTIO] 4.1.4.8 "Legacy
+   Interfaces" and 5.2 "Block Device".
+
+   Each disk has a single virtqueue.  The block layer's dispatch
+   thread hands the driver one request at a time, which goes to
+   the device as one chain of descriptors: a header, the data,
+   one descriptor per physically contiguous region, and a status
+   byte.  The thread then sleeps until the device interrupts. */
+
+/* PCI IDs of a transitional virtio block device. */
+#define VIRTIO_VENDOR 0x1af4
+#define VIRTIO_BLK_DEVICE 0x1001
+
+/* Legacy registers, in the I/O space of BAR0. */
+#define reg_features(D) ((D)->io_base + 0x00)      /* Device features. */
+#define reg_guest_features(D) ((D)->io_base + 0x04) /* Driver features. */
+#define reg_queue_pfn(D) ((D)->io_base + 0x08)     /* Queue page number. */
+#define reg_queue_size(D) ((D)->io_base + 0x0c)    /* Queue size (r/o). */
+#define reg_queue_select(D) ((D)->io_base + 0x0e)  /* Queue selector. */
+#define reg_queue_notify(D) ((D)->io_base + 0x10)  /* Queue notifier. */
+#define reg_status(D) ((D)->io_base + 0x12)        /* Device status. */
+#define reg_isr(D) ((D)->io_base + 0x13)           /* ISR status. */
+#define reg_capacity(D) ((D)->io_base + 0x14)      /* Sectors, 64 bits. */
+
+/* Device status bits. */
+#define STA_ACKNOWLEDGE 0x01    /* Guest has noticed the device. */
+#define STA_DRIVER 0x02         /* Guest has a driver for it. */
+#define STA_DRIVER_OK 0x04      /* Driver is ready. */
+
+/* ISR status bit. */
+#define ISR_QUEUE 0x01          /* A used ring has new entries. */
+
+/* Descriptor flags. */
+#define DESC_NEXT 0x01          /* Chain continues in NEXT. */
+#define DESC_WRITE 0x02         /* Device writes the buffer. */
+
+/* A virtqueue descriptor. */
+struct vring_desc
+  {
+    uint64_t addr;              /* Physical address of buffer. */
+    uint32_t len;               /* Length of buffer in bytes. */
+    uint16_t flags;             /* DESC_* flags. */
+    uint16_t next;              /* Next descriptor, if DESC_NEXT. */
+  };
+
+/* Ring of descriptor chains the driver offers the device. */
+struct vring_avail
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Free-running index of next entry. */
+    uint16_t ring[];            /* Heads of descriptor chains. */
+  };
+
+/* An entry in the used ring. */
+struct vring_used_elem
+  {
+    uint32_t id;                /* Head of the chain used. */
+    uint32_t len;               /* Bytes the device wrote. */
+  };
+
+/* Ring of descriptor chains the device has finished with. */
+struct vring_used
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Free-running index of next entry. */
+    struct vring_used_elem ring[];
+  };
+
+/* Block request header, read by the device. */
+struct virtio_blk_header
+  {
+    uint32_t type;              /* BLK_T_*. */
+    uint32_t reserved;
+    uint64_t sector;            /* First sector. */
+  };
+
+/* Request types. */
+#define BLK_T_IN 0              /* Read. */
+#define BLK_T_OUT 1             /* Write. */
+
+/* Request status written by the device. */
+#define BLK_S_OK 0
+
+/* Most sectors moved by one request, and the most data
+   descriptors that many sectors can need. */
+#define VIRTIO_MAX_SECTORS 128
+#define VIRTIO_MAX_SEGS (VIRTIO_MAX_SECTORS * BLOCK_SECTOR_SIZE / PGSIZE + 1)
+
+/* Most virtio disks supported. */
+#define VIRTIO_MAX_DISKS 4
+
+/* A virtio disk. */
+struct virtio_disk
+  {
+    char name[8];               /* Name, e.g. "vda". */
+    uint16_t io_base;           /* Base I/O port of legacy registers. */
+    uint8_t irq;                /* Interrupt vector in use. */
+
+    /* Virtqueue. */
+    uint16_t queue_size;        /* Number of descriptors. */
+    struct vring_desc *desc;    /* Descriptor table. */
+    struct vring_avail *avail;  /* Available ring. */
+    volatile struct vring_used *used; /* Used ring. */
+    uint16_t used_idx;          /* Used ring entries consumed. */
+
+    /* Header and status of the request in flight, in one page. */
+    struct virtio_blk_header *header;
+    volatile uint8_t *status;
+
+    struct lock lock;           /* Serializes requests. */
+    struct semaphore completion; /* Up'd by interrupt handler. */
+  };
+
+static struct virtio_disk disks[VIRTIO_MAX_DISKS];
+static size_t disk_cnt;
+
+static struct block_operations virtio_operations;
+
+static pci_scan_func probe_disk;
+static bool init_queue (struct virtio_disk *);
+static intr_handler_func interrupt_handler;
+
+/* Finds the virtio block devices on the PCI buses and registers
+   each one as a block device. */
+void
+virtio_init (void)
+{
+  pci_scan (probe_disk, NULL);
+}
+
+/* pci_scan() function that sets up and registers PCI function
+   PCI if it is a virtio block device.  Stops the scan once
+   VIRTIO_MAX_DISKS disks have been found. */
+static bool
+probe_disk (const struct pci_dev *pci, void *aux UNUSED)
+{
+  struct virtio_disk *d = &disks[disk_cnt];
+  uint32_t bar0;
+  uint8_t irq;
+  uint64_t capacity;
+  struct block *block;
+  size_t i;
+
+  if (pci_read_config (pci, PCI_REG_ID)
+      != ((VIRTIO_BLK_DEVICE << 16) | VIRTIO_VENDOR))
+    return false;
+
+  snprintf (d->name, sizeof d->name, "vd%c", 'a' + (int) disk_cnt);
+  bar0 = pci_read_config (pci, PCI_REG_BAR0);
+  irq = pci_read_config (pci, PCI_REG_INTR) & 0xff;
+  if (!(bar0 & 1) || irq >= 16)
+    {
+      printf ("%s: no I/O ports or interrupt, ignoring\n", d->name);
+      return false;
+    }
+  d->io_base = bar0 & 0xfffc;
+  d->irq = irq + 0x20;
+  lock_init (&d->lock);
+  sema_init (&d->completion, 0);
+  pci_enable_master (pci);
+
+  /* Reset the device and tell it we drive it, accepting none of
+     its optional features. */
+  outb (reg_status (d), 0);
+  outb (reg_status (d), STA_ACKNOWLEDGE);
+  outb (reg_status (d), STA_ACKNOWLEDGE | STA_DRIVER);
+  inl (reg_features (d));
+  outl (reg_guest_features (d), 0);
+  if (!init_queue (d))
+    {
+      printf ("%s: cannot set up virtqueue, ignoring\n", d->name);
+      outb (reg_status (d), 0);
+      return false;
+    }
+
+  /* Disks may share an interrupt line; register its handler
+     once. */
+  for (i = 0; i < disk_cnt; i++)
+    if (disks[i].irq == d->irq)
+      break;
+  if (i == disk_cnt)
+    intr_register_ext (d->irq, interrupt_handler, "virtio");
+  disk_cnt++;
+
+  outb (reg_status (d), STA_ACKNOWLEDGE | STA_DRIVER | STA_DRIVER_OK);
+
+  /* Capacity is 64 bits, but block_sector_t is only 32. */
+  capacity = inl (reg_capacity (d))
+             | ((uint64_t) inl (reg_capacity (d) + 4) << 32);
+  if (capacity > UINT32_MAX)
+    capacity = UINT32_MAX;
+
+  block = block_register (d->name, BLOCK_RAW, "virtio", capacity,
+                          &virtio_operations, d);
+  partition_scan (block);
+
+  return disk_cnt == VIRTIO_MAX_DISKS;
+}
+
+/* Allocates and tells disk D about its virtqueue.  The legacy
+   layout puts the descriptor table and available ring in the
+   first pages and the used ring at the next page boundary, all
+   physically contiguous.  Returns false if the queue is too
+   small for our requests or memory is short. */
+static bool
+init_queue (struct virtio_disk *d)
+{
+  size_t qs, avail_end, used_size;
+  uint8_t *queue;
+
+  outw (reg_queue_select (d), 0);
+  qs = d->queue_size = inw (reg_queue_size (d));
+  if (qs < VIRTIO_MAX_SEGS + 2)
+    return false;
+
+  avail_end = ROUND_UP (qs * sizeof (struct vring_desc)
+                        + sizeof (struct vring_avail) + qs * sizeof (uint16_t)
+                        + sizeof (uint16_t), PGSIZE);
+  used_size = (sizeof (struct vring_used)
+               + qs * sizeof (struct vring_used_elem) + sizeof (uint16_t));
+  queue = palloc_get_multiple (PAL_ZERO,
+                               DIV_ROUND_UP (avail_end + used_size, PGSIZE));
+  d->header = palloc_get_page (PAL_ZERO);
+  if (queue == NULL || d->header == NULL)
+    {
+      palloc_free_multiple (queue,
+                            DIV_ROUND_UP (avail_end + used_size, PGSIZE));
+      palloc_free_page (d->header);
+      return false;
+    }
+  d->status = (uint8_t *) (d->header + 1);
+
+  d->desc = (struct vring_desc *) queue;
+  d->avail = (struct vring_avail *) (queue + qs * sizeof (struct vring_desc));
+  d->used = (struct vring_used *) (queue + avail_end);
+  d->used_idx = 0;
+
+  outl (reg_queue_pfn (d), vtop (queue) / PGSIZE);
+  return true;
+}
+
+/* Sets descriptor N of disk D to describe the SIZE bytes at
+   physical address ADDR, with FLAGS, and chains it to the next
+   descriptor. */
+static void
+set_desc (struct virtio_disk *d, size_t n, uintptr_t addr, size_t size,
+          uint16_t flags)
+{
+  d->desc[n].addr = addr;
+  d->desc[n].len = size;
+  d->desc[n].flags = flags | DESC_NEXT;
+  d->desc[n].next = n + 1;
+}
+
+/* Moves the CNT sectors starting at SEC_NO between disk D and
+   BUFFER, into BUFFER if WRITE is false and out of it if WRITE is
+   true, as one request.  CNT must not exceed VIRTIO_MAX_SECTORS.
+   D's lock must be held. */
+static void
+transfer (struct virtio_disk *d, block_sector_t sec_no, size_t cnt,
+          const void *buffer, bool write)
+{
+  const uint8_t *p = buffer;
+  size_t size = cnt * BLOCK_SECTOR_SIZE;
+  uint16_t data_flags = write ? 0 : DESC_WRITE;
+  size_t n;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+  ASSERT (cnt <= VIRTIO_MAX_SECTORS);
+
+  d->header->type = write ? BLK_T_OUT : BLK_T_IN;
+  d->header->reserved = 0;
+  d->header->sector = sec_no;
+  *d->status = 0xff;
+  set_desc (d, 0, vtop (d->header), sizeof *d->header, 0);
+
+  /* One descriptor per physically contiguous region of BUFFER. */
+  for (n = 1; size > 0; )
+    {
+      uintptr_t addr = kernel_vtop (p);
+      size_t chunk = PGSIZE - pg_ofs (p);
+      if (chunk > size)
+        chunk = size;
+
+      if (n > 1 && d->desc[n - 1].addr + d->desc[n - 1].len == addr)
+        d->desc[n - 1].len += chunk;
+      else
+        set_desc (d, n++, addr, chunk, data_flags);
+      p += chunk;
+      size -= chunk;
+    }
+
+  set_desc (d, n, vtop ((const void *) d->status), 1, DESC_WRITE);
+  d->desc[n].flags &= ~DESC_NEXT;
+
+  /* Offer the chain, which starts at descriptor 0, and wait for
+     the device to hand it back.  The interrupt handler may have
+     up'd the semaphore for an earlier interrupt, so recheck. */
+  d->avail->ring[d->avail->idx % d->queue_size] = 0;
+  barrier ();
+  d->avail->idx++;
+  barrier ();
+  outw (reg_queue_notify (d), 0);
+  while (d->used->idx == d->used_idx)
+    sema_down (&d->completion);
+  d->used_idx++;
+
+  if (*d->status != BLK_S_OK)
+    PANIC ("%s: disk %s failed, sector=%"PRDSNu,
+           d->name, write ? "write" : "read", sec_no);
+}
+
+/* Reads CNT sectors starting at SEC_NO from disk D into BUFFER,
+   which must have room for CNT * BLOCK_SECTOR_SIZE bytes, using
+   one request per VIRTIO_MAX_SECTORS sectors.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+virtio_read_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                      void *buffer)
+{
+  struct virtio_disk *d = d_;
+  uint8_t *p = buffer;
+
+  lock_acquire (&d->lock);
+  while (cnt > 0)
+    {
+      size_t n = cnt < VIRTIO_MAX_SECTORS ? cnt : VIRTIO_MAX_SECTORS;
+      transfer (d, sec_no, n, p, false);
+      sec_no += n;
+      p += n * BLOCK_SECTOR_SIZE;
+      cnt -= n;
+    }
+  lock_release (&d->lock);
+}
+
+/* Write CNT sectors starting at SEC_NO to disk D from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes, using one
+   request per VIRTIO_MAX_SECTORS sectors.  Returns after the
+   disk has acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+virtio_write_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                       const void *buffer)
+{
+  struct virtio_disk *d = d_;
+  const uint8_t *p = buffer;
+
+  lock_acquire (&d->lock);
+  while (cnt > 0)
+    {
+      size_t n = cnt < VIRTIO_MAX_SECTORS ? cnt : VIRTIO_MAX_SECTORS;
+      transfer (d, sec_no, n, p, true);
+      sec_no += n;
+      p += n * BLOCK_SECTOR_SIZE;
+      cnt -= n;
+    }
+  lock_release (&d->lock);
+}
+
+/* Reads sector SEC_NO from disk D into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes. */
+static void
+virtio_read (void *d, block_sector_t sec_no, void *buffer)
+{
+  virtio_read_multiple (d, sec_no, 1, buffer);
+}
+
+/* Write sector SEC_NO to disk D from BUFFER, which must contain
+   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data. */
+static void
+virtio_write (void *d, block_sector_t sec_no, const void *buffer)
+{
+  virtio_write_multiple (d, sec_no, 1, buffer);
+}
+
+static struct block_operations virtio_operations =
+  {
+    virtio_read,
+    virtio_write,
+    virtio_read_multiple,
+    virtio_write_multiple,
+    NULL
+  };
+
+/* virtio interrupt handler.  Reading a disk's ISR status
+   acknowledges its interrupt, so check every disk on the line. */
+static void
+interrupt_handler (struct intr_frame *f)
+{
+  size_t i;
+
+  for (i = 0; i < disk_cnt; i++)
+    {
+      struct virtio_disk *d = &disks[i];
+      if (d->irq == f->vec_no && (inb (reg_isr (d)) & ISR_QUEUE))
+        sema_up (&d->completion);
+    }
+}
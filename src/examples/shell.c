@@ -3,8 +3,12 @@
 #include <string.h>
 #include <syscall.h>
 
+/* Maximum number of commands in a pipeline. */
+#define MAX_STAGES 8
+
 static void read_line (char line[], size_t);
 static bool backspace (char **pos, char line[]);
+static void run_pipeline (char *command);
 
 int
 main (void)
@@ -30,6 +34,8 @@ main (void)
         {
           /* Empty command. */
         }
+      else if (strchr (command, '|') != NULL)
+        run_pipeline (command);
       else
         {
           pid_t pid = exec (command);
@@ -102,3 +108,75 @@ backspace (char **pos, char line[])
   else
     return false;
 }
+
+/* Runs each of the commands in COMMAND, which are separated by
+   "|", with its standard output connected through a pipe to the
+   standard input of the next, then waits for all of them. */
+static void
+run_pipeline (char *command)
+{
+  char *stages[MAX_STAGES];
+  pid_t pids[MAX_STAGES];
+  int stage_cnt = 0;
+  int in = -1;
+  char *stage, *save_ptr;
+  int i;
+
+  for (stage = strtok_r (command, "|", &save_ptr); stage != NULL;
+       stage = strtok_r (NULL, "|", &save_ptr))
+    {
+      while (*stage == ' ')
+        stage++;
+      if (stage_cnt >= MAX_STAGES)
+        {
+          printf ("too many commands in pipeline\n");
+          return;
+        }
+      stages[stage_cnt++] = stage;
+    }
+
+  for (i = 0; i < stage_cnt; i++)
+    {
+      bool last = i == stage_cnt - 1;
+      int fds[2];
+
+      /* Point our standard input and output at the pipes this
+         stage should use, so that the child inherits them. */
+      if (in >= 0)
+        {
+          dup2 (in, STDIN_FILENO);
+          close (in);
+        }
+      if (!last)
+        {
+          if (!pipe (fds))
+            {
+              if (in >= 0)
+                close (STDIN_FILENO);
+              printf ("pipe failed\n");
+              stage_cnt = i;
+              break;
+            }
+          dup2 (fds[1], STDOUT_FILENO);
+          close (fds[1]);
+        }
+
+      pids[i] = exec (stages[i]);
+
+      /* Return to the console, keeping only the reading end of
+         the new pipe for the next stage. */
+      if (in >= 0)
+        close (STDIN_FILENO);
+      if (!last)
+        {
+          close (STDOUT_FILENO);
+          in = fds[0];
+        }
+      if (pids[i] == PID_ERROR)
+        printf ("\"%s\": exec failed\n", stages[i]);
+    }
+
+  for (i = 0; i < stage_cnt; i++)
+    if (pids[i] != PID_ERROR)
+      printf ("\"%s\": exit code %d\n", stages[i], wait (pids[i]));
+}
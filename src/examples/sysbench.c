@@ -0,0 +1,60 @@
+/* sysbench.c
+
+   Measures the cost of a minimal system call, entering the
+   kernel first with "int $0x30" and then with SYSENTER, if the
+   CPU supports it.
+
+   Usage: sysbench [ITERATIONS] */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+/* Returns the CPU's time stamp counter. */
+static uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Makes ITERATIONS calls to wait(PID_ERROR), which the kernel
+   rejects right away, and returns the average cycles per call. */
+static unsigned
+measure (int iterations)
+{
+  uint64_t start = rdtsc ();
+  int i;
+
+  for (i = 0; i < iterations; i++)
+    wait (PID_ERROR);
+  return (rdtsc () - start) / iterations;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int iterations = argc > 1 ? atoi (argv[1]) : 10000;
+  bool have_sysenter = syscall_use_sysenter;
+
+  if (iterations <= 0)
+    {
+      printf ("usage: sysbench [ITERATIONS]\n");
+      return EXIT_FAILURE;
+    }
+
+  syscall_use_sysenter = false;
+  printf ("int $0x30: %u cycles per call\n", measure (iterations));
+
+  if (have_sysenter)
+    {
+      syscall_use_sysenter = true;
+      printf ("sysenter:  %u cycles per call\n", measure (iterations));
+    }
+  else
+    printf ("sysenter:  not supported by this CPU\n");
+
+  return EXIT_SUCCESS;
+}
@@ -4,8 +4,9 @@
 #include "kernel/list.h"
 #include "string.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
-#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* Size of file system cache. */
 #define FILESYS_CACHE_SIZE 64
@@ -13,15 +14,30 @@
 /* Number of ticks to synchronize the cache. */
 #define FILESYS_CACHE_TICKS 10000
 
+/* Pages in the run buffer, and the most consecutive sectors moved
+   between the cache and disk with one device request. */
+#define FILESYS_RUN_PAGES 4
+#define FILESYS_RUN_SECTORS (FILESYS_RUN_PAGES * PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Owner that makes filesys_cache_flush() write back every dirty
+   block. */
+#define OWNER_ANY ((block_sector_t) -1)
+
 /* A block cache. */
 struct block_cache_elem
 {
   block_sector_t sector; /* Sector number of block. */
+  block_sector_t owner;  /* Sector of the inode the block belongs to,
+                            as of the last write. */
 
   bool in_use; /* Is in use or free? */
   bool dirty;  /* Is dirty or clean? */
   bool access; /* Is accessed or not? */
   bool pin;    /* Is pinned or not? */
+  bool loading; /* Is being read in by read-ahead? */
+
+  /* Read-ahead request, while LOADING. */
+  struct block_request req;
 
   /* Cache data, size should be BLOCK_SECTOR_SIZE. */
   uint8_t data[BLOCK_SECTOR_SIZE];
@@ -46,17 +62,30 @@ static int64_t ticks;
 /* The next write operation should be synchronized. */
 static bool sync_write = false;
 
+/* Buffer for gathering a run of sectors, FILESYS_RUN_PAGES pages.
+   Protected by filesys_cache_lock. */
+static uint8_t *run_buffer;
+
+/* Most read-ahead reads in flight at once. */
+#define READAHEAD_LOADS_MAX 32
+
+/* Number of blocks being read in by read-ahead.
+   Protected by filesys_cache_lock. */
+static int readahead_loads;
+
 /* Initialize file system cache. */
 void
 filesys_cache_init (void)
 {
   lock_init (&filesys_cache_lock);
+  run_buffer = palloc_get_multiple (PAL_ASSERT, FILESYS_RUN_PAGES);
 }
 
-/* Look up a block in file system cache.
+/* Find a block in file system cache, whether or not its
+   read-ahead is over.
    Return NULL if not found. */
 static struct block_cache_elem *
-filesys_cache_lookup (block_sector_t sector)
+filesys_cache_find (block_sector_t sector)
 {
   for (int i = 0; i < FILESYS_CACHE_SIZE; i++)
     {
@@ -66,6 +95,31 @@ filesys_cache_lookup (block_sector_t sector)
   return NULL;
 }
 
+/* Reap the read-ahead of ELEM, waiting for it if needed, and
+   unpin it. */
+static void
+filesys_cache_finish_load (struct block_cache_elem *elem)
+{
+  ASSERT (elem->loading);
+
+  block_wait (&elem->req);
+  elem->loading = false;
+  elem->pin = false;
+  readahead_loads--;
+}
+
+/* Look up a block in file system cache, waiting for its
+   read-ahead if it is still being read in.
+   Return NULL if not found. */
+static struct block_cache_elem *
+filesys_cache_lookup (block_sector_t sector)
+{
+  struct block_cache_elem *elem = filesys_cache_find (sector);
+  if (elem != NULL && elem->loading)
+    filesys_cache_finish_load (elem);
+  return elem;
+}
+
 /* Write back a block in file system cache. */
 static void
 filesys_cache_write_back (struct block_cache_elem *elem)
@@ -96,6 +150,10 @@ filesys_cache_evict (void)
       if (!elem->in_use)
         return elem;
 
+      /* If the block's read-ahead is over, reap it. */
+      if (elem->loading && block_request_done (&elem->req))
+        filesys_cache_finish_load (elem);
+
       /* If the block is pinned, skip it. */
       if (elem->pin)
         continue;
@@ -138,9 +196,11 @@ filesys_cache_access (block_sector_t sector, bool read)
 
       elem->in_use = true;
       elem->sector = sector;
+      elem->owner = sector;
       elem->dirty = false;
       elem->access = false;
       elem->pin = false;
+      elem->loading = false;
 
       if (read)
         block_read (fs_device, elem->sector, elem->data);
@@ -151,25 +211,125 @@ filesys_cache_access (block_sector_t sector, bool read)
   return elem;
 }
 
+/* Returns true if ELEM is a dirty block that
+   filesys_cache_flush (OWNER, WITH_INODE) should write back. */
+static bool
+filesys_cache_flush_match (const struct block_cache_elem *elem,
+                           block_sector_t owner, bool with_inode)
+{
+  return (elem != NULL && elem->in_use && elem->dirty
+          && (owner == OWNER_ANY
+              || (elem->owner == owner
+                  && (with_inode || elem->sector != owner))));
+}
+
+/* Write back the dirty blocks in file system cache that belong to
+   the inode at sector OWNER, or all of them if OWNER is OWNER_ANY.
+   The inode's own sector is written back only if WITH_INODE is
+   true.  Blocks are written lowest sector first, each run of up
+   to FILESYS_RUN_SECTORS consecutive sectors with one device
+   request.
+   This function does not acquire filesys_cache_lock. */
+static void
+filesys_cache_flush (block_sector_t owner, bool with_inode)
+{
+  for (;;)
+    {
+      struct block_cache_elem *first = NULL;
+      for (int i = 0; i < FILESYS_CACHE_SIZE; i++)
+        {
+          struct block_cache_elem *elem = &filesys_cache[i];
+          if (filesys_cache_flush_match (elem, owner, with_inode)
+              && (first == NULL || elem->sector < first->sector))
+            first = elem;
+        }
+      if (first == NULL)
+        break;
+
+      /* Gather the run that starts at FIRST. */
+      block_sector_t sector = first->sector;
+      struct block_cache_elem *elem = first;
+      size_t cnt = 0;
+      while (cnt < FILESYS_RUN_SECTORS
+             && filesys_cache_flush_match (elem, owner, with_inode))
+        {
+          memcpy (run_buffer + cnt * BLOCK_SECTOR_SIZE, elem->data,
+                  BLOCK_SECTOR_SIZE);
+          elem->dirty = false;
+          cnt++;
+          elem = filesys_cache_lookup (sector + cnt);
+        }
+      block_write_multiple (fs_device, sector, cnt, run_buffer);
+    }
+}
+
 /* Write back all dirty blocks in file system cache.
    This function does not acquire filesys_cache_lock. */
 static void
 filesys_sync_nolock (void)
 {
-  for (int i = 0; i < FILESYS_CACHE_SIZE; i++)
+  filesys_cache_flush (OWNER_ANY, true);
+}
+
+/* Starts reading SECTOR into file system cache in the background.
+   Does nothing if the sector is cached already or
+   READAHEAD_LOADS_MAX reads are in flight.  The block stays
+   pinned until the read is reaped by filesys_cache_lookup() or
+   filesys_cache_evict(). */
+void
+filesys_readahead (block_sector_t sector)
+{
+  lock_acquire (&filesys_cache_lock);
+
+  if (cache_enabled && readahead_loads < READAHEAD_LOADS_MAX
+      && filesys_cache_find (sector) == NULL)
     {
-      struct block_cache_elem *elem = &filesys_cache[i];
-      if (elem->dirty)
-        filesys_cache_write_back (elem);
-      elem->dirty = false;
+      struct block_cache_elem *elem = filesys_cache_access (sector, false);
+      if (elem != NULL)
+        {
+          elem->loading = true;
+          elem->pin = true;
+          readahead_loads++;
+          block_request_init (&elem->req, sector, 1, elem->data, false,
+                              NULL, NULL);
+          block_submit (fs_device, &elem->req);
+        }
     }
+
+  lock_release (&filesys_cache_lock);
 }
 
-/* Prefetch a block in file system cache. */
-static void
-filesys_prefetch (block_sector_t sector)
+/* Makes SECTOR, if it is cached, the first candidate for
+   eviction, by clearing its access bit. */
+void
+filesys_cache_demote (block_sector_t sector)
+{
+  lock_acquire (&filesys_cache_lock);
+
+  struct block_cache_elem *elem = filesys_cache_lookup (sector);
+  if (elem != NULL)
+    elem->access = false;
+
+  lock_release (&filesys_cache_lock);
+}
+
+/* Evicts SECTOR from file system cache, writing it back first if
+   it is dirty.  Does nothing if the sector is not cached or is
+   pinned. */
+void
+filesys_cache_drop (block_sector_t sector)
 {
-  filesys_cache_access (sector, true);
+  lock_acquire (&filesys_cache_lock);
+
+  struct block_cache_elem *elem = filesys_cache_lookup (sector);
+  if (elem != NULL && !elem->pin)
+    {
+      if (elem->dirty)
+        filesys_cache_write_back (elem);
+      elem->in_use = false;
+    }
+
+  lock_release (&filesys_cache_lock);
 }
 
 /* Write back all dirty blocks in file system cache. */
@@ -184,6 +344,21 @@ filesys_sync (void)
   lock_release (&filesys_cache_lock);
 }
 
+/* Write back the dirty blocks in file system cache that belong to
+   the inode at sector OWNER: its data blocks and indirect blocks,
+   and the inode's own sector if WITH_INODE is true.  Blocks of
+   other files stay dirty. */
+void
+filesys_sync_owner (block_sector_t owner, bool with_inode)
+{
+  lock_acquire (&filesys_cache_lock);
+
+  if (cache_enabled)
+    filesys_cache_flush (owner, with_inode);
+
+  lock_release (&filesys_cache_lock);
+}
+
 /* Reads sector SECTOR from file system into BUFFER, which must
    have room for BLOCK_SECTOR_SIZE bytes.
 
@@ -211,9 +386,6 @@ filesys_block_read (block_sector_t sector, void *buffer)
       return;
     }
 
-  if (sector + 1 < block_size (fs_device))
-    filesys_prefetch (sector + 1);
-
   memcpy (buffer, elem->data, BLOCK_SECTOR_SIZE);
 
   lock_release (&filesys_cache_lock);
@@ -250,14 +422,16 @@ filesys_block_read_bytes (block_sector_t sector, void *buffer, off_t ofs,
   lock_release (&filesys_cache_lock);
 }
 
-/* Write sector SECTOR to file system from BUFFER, which must contain
+/* Write sector SECTOR, which belongs to the inode at sector OWNER,
+   to file system from BUFFER, which must contain
    BLOCK_SECTOR_SIZE bytes.  Returns after the block device has
    acknowledged receiving the data.
 
    If the block exists in the cache, write it.
    Otherwise, load it first, then write it to cache. */
 void
-filesys_block_write (block_sector_t sector, const void *buffer)
+filesys_block_write (block_sector_t sector, const void *buffer,
+                     block_sector_t owner)
 {
   if (!cache_enabled)
     {
@@ -270,6 +444,52 @@ filesys_block_write (block_sector_t sector, const void *buffer)
   struct block_cache_elem *elem = filesys_cache_access (sector, false);
   memcpy (elem->data, buffer, BLOCK_SECTOR_SIZE);
   elem->dirty = true;
+  elem->owner = owner;
+
+  if (sync_write)
+    {
+      filesys_sync_nolock ();
+      sync_write = false;
+    }
+
+  lock_release (&filesys_cache_lock);
+}
+
+/* Copies the contents of sector SRC to sector DST, which belongs
+   to the inode at sector OWNER, block to block within the cache,
+   without reading DST from disk. */
+void
+filesys_block_copy (block_sector_t dst, block_sector_t src,
+                    block_sector_t owner)
+{
+  if (!cache_enabled)
+    {
+      uint8_t *bounce = malloc (BLOCK_SECTOR_SIZE);
+      if (bounce == NULL)
+        PANIC ("out of memory");
+      block_read (fs_device, src, bounce);
+      block_write (fs_device, dst, bounce);
+      free (bounce);
+      return;
+    }
+
+  lock_acquire (&filesys_cache_lock);
+
+  /* Pin SRC so that bringing in DST cannot evict it. */
+  struct block_cache_elem *src_elem = filesys_cache_access (src, true);
+  if (src_elem == NULL)
+    PANIC ("filesys_block_copy: cache access failed");
+  bool was_pinned = src_elem->pin;
+  src_elem->pin = true;
+
+  struct block_cache_elem *dst_elem = filesys_cache_access (dst, false);
+  src_elem->pin = was_pinned;
+  if (dst_elem == NULL)
+    PANIC ("filesys_block_copy: cache access failed");
+
+  memcpy (dst_elem->data, src_elem->data, BLOCK_SECTOR_SIZE);
+  dst_elem->dirty = true;
+  dst_elem->owner = owner;
 
   if (sync_write)
     {
@@ -280,12 +500,13 @@ filesys_block_write (block_sector_t sector, const void *buffer)
   lock_release (&filesys_cache_lock);
 }
 
-/* Write BYTES of sector SECTOR to file system from BUFFER, starting at
-   offset OFS_OFFSET. Returns after the block device has acknowledged
+/* Write BYTES of sector SECTOR, which belongs to the inode at
+   sector OWNER, to file system from BUFFER, starting at offset
+   OFS_OFFSET. Returns after the block device has acknowledged
    receiving the data. */
 void
 filesys_block_write_bytes (block_sector_t sector, const void *buffer,
-                           off_t ofs, uint32_t bytes)
+                           off_t ofs, uint32_t bytes, block_sector_t owner)
 {
   /* If cache is disabled, write directly to disk. */
   if (!cache_enabled)
@@ -304,6 +525,7 @@ filesys_block_write_bytes (block_sector_t sector, const void *buffer,
   struct block_cache_elem *elem = filesys_cache_access (sector, true);
   memcpy (elem->data + ofs, buffer, bytes);
   elem->dirty = true;
+  elem->owner = owner;
 
   if (sync_write)
     {
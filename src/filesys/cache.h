@@ -8,6 +8,7 @@
 
 #include "devices/block.h"
 #include "filesys/off_t.h"
+#include <stdbool.h>
 
 /* Initialization, enabling, and disabling. */
 
@@ -18,18 +19,29 @@ void filesys_cache_disable (void);
 /* Write all dirty blocks to disk. */
 
 void filesys_sync (void);
+void filesys_sync_owner (block_sector_t owner, bool with_inode);
 
 /* Read/write a block from/to the cache. */
 
-void filesys_block_write (block_sector_t sector, const void *buffer);
+void filesys_block_write (block_sector_t sector, const void *buffer,
+                          block_sector_t owner);
 void filesys_block_read (block_sector_t sector, void *buffer);
+void filesys_block_copy (block_sector_t dst, block_sector_t src,
+                         block_sector_t owner);
 
 /* Read/write some parts in a block from/to the cache. */
 
 void filesys_block_read_bytes (block_sector_t sector, void *buffer, off_t ofs,
                                uint32_t bytes);
 void filesys_block_write_bytes (block_sector_t sector, const void *buffer,
-                                off_t ofs, uint32_t bytes);
+                                off_t ofs, uint32_t bytes,
+                                block_sector_t owner);
+
+/* Read-ahead and eviction hints. */
+
+void filesys_readahead (block_sector_t sector);
+void filesys_cache_demote (block_sector_t sector);
+void filesys_cache_drop (block_sector_t sector);
 
 void filesys_cache_tick (void);
 
@@ -1,14 +1,33 @@
 #include "filesys/file.h"
 #include "filesys/inode.h"
+#include "filesys/pipe.h"
 #include "threads/malloc.h"
 #include <debug.h>
+#include <fadvise.h>
 
-/* An open file. */
+/* Read-ahead window, in bytes, after the first sequential read,
+   and the most it grows to by doubling on each further one. */
+#define READAHEAD_WINDOW_MIN (2 * BLOCK_SECTOR_SIZE)
+#define READAHEAD_WINDOW_MAX (32 * BLOCK_SECTOR_SIZE)
+
+/* An open file, or one end of a pipe.
+
+   sys_readdir() treats a file as a struct dir, so INODE and POS
+   must stay the first members. */
 struct file
 {
-  struct inode *inode; /* File's inode. */
+  struct inode *inode; /* File's inode, null for a pipe end. */
   off_t pos;           /* Current position. */
   bool deny_write;     /* Has file_deny_write() been called? */
+  struct pipe *pipe;   /* Pipe, for a pipe end. */
+  bool write_end;      /* For a pipe end, is it the writing end? */
+  bool cancelled;      /* For a pipe end, has file_cancel() been called? */
+  int advice;          /* POSIX_FADV_* access pattern for reads. */
+
+  /* Read-ahead state. */
+  off_t ra_next;       /* Offset where a sequential read would start. */
+  off_t ra_window;     /* Bytes to keep read ahead of the reader. */
+  off_t ra_end;        /* End of the data read ahead so far. */
 };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -33,11 +52,52 @@ file_open (struct inode *inode)
     }
 }
 
-/* Opens and returns a new file for the same inode as FILE.
-   Returns a null pointer if unsuccessful. */
+/* Opens and returns a new file for the reading or writing end of
+   PIPE, according to WRITE_END.  Returns a null pointer if an
+   allocation fails. */
+static struct file *
+open_pipe_end (struct pipe *pipe, bool write_end)
+{
+  struct file *file = calloc (1, sizeof *file);
+  if (file != NULL)
+    {
+      file->pipe = pipe;
+      file->write_end = write_end;
+      pipe_open (pipe, write_end);
+    }
+  return file;
+}
+
+/* Creates a pipe and opens its reading end in *READ_END and its
+   writing end in *WRITE_END.  Returns true if successful, false
+   if memory is short. */
+bool
+file_open_pipe (struct file **read_end, struct file **write_end)
+{
+  struct pipe *pipe = pipe_create ();
+  if (pipe == NULL)
+    return false;
+
+  *read_end = open_pipe_end (pipe, false);
+  *write_end = open_pipe_end (pipe, true);
+  if (*read_end == NULL || *write_end == NULL)
+    {
+      /* Closing the ends that did open frees the pipe. */
+      file_close (*read_end);
+      file_close (*write_end);
+      return false;
+    }
+  return true;
+}
+
+/* Opens and returns a new file for the same inode as FILE, or a
+   new file for the same end of the same pipe.  Returns a null
+   pointer if unsuccessful. */
 struct file *
 file_reopen (struct file *file)
 {
+  if (file->pipe != NULL)
+    return open_pipe_end (file->pipe, file->write_end);
   return file_open (inode_reopen (file->inode));
 }
 
@@ -47,41 +107,154 @@ file_close (struct file *file)
 {
   if (file != NULL)
     {
-      file_allow_write (file);
-      inode_close (file->inode);
+      if (file->pipe != NULL)
+        pipe_close (file->pipe, file->write_end);
+      else
+        {
+          file_allow_write (file);
+          inode_close (file->inode);
+        }
       free (file);
     }
 }
 
-/* Returns the inode encapsulated by FILE. */
+/* Makes reads and writes of pipe end FILE, whether waiting now or
+   started later, return at once with whatever they have
+   transferred.  Does nothing if FILE is not a pipe end. */
+void
+file_cancel (struct file *file)
+{
+  if (file->pipe != NULL)
+    pipe_cancel (file->pipe, &file->cancelled);
+}
+
+/* Returns true if FILE is one end of a pipe. */
+bool
+file_is_pipe (struct file *file)
+{
+  return file->pipe != NULL;
+}
+
+/* Returns the inode encapsulated by FILE, or a null pointer if
+   FILE is a pipe end. */
 struct inode *
 file_get_inode (struct file *file)
 {
   return file->inode;
 }
 
+/* Follows up a read of SIZE bytes at OFFSET in FILE by reading
+   ahead.  A read that starts where the last one ended doubles
+   FILE's read-ahead window, up to READAHEAD_WINDOW_MAX, and any
+   other read closes it.  Then the part of the window past the
+   data already read ahead is queued for prefetch.
+
+   POSIX_FADV_SEQUENTIAL keeps the window at its largest and
+   POSIX_FADV_RANDOM turns read-ahead off.  POSIX_FADV_NOREUSE
+   also marks the data read for eviction. */
+static void
+file_read_done (struct file *file, off_t offset, off_t size)
+{
+  if (size <= 0)
+    return;
+
+  if (file->advice == POSIX_FADV_NOREUSE)
+    inode_uncache (file->inode, offset, size, false);
+
+  if (file->advice == POSIX_FADV_RANDOM)
+    file->ra_window = 0;
+  else if (file->advice == POSIX_FADV_SEQUENTIAL)
+    file->ra_window = READAHEAD_WINDOW_MAX;
+  else if (offset != file->ra_next)
+    file->ra_window = 0;
+  else if (file->ra_window == 0)
+    file->ra_window = READAHEAD_WINDOW_MIN;
+  else if (file->ra_window < READAHEAD_WINDOW_MAX)
+    file->ra_window *= 2;
+  file->ra_next = offset + size;
+
+  off_t start = file->ra_next;
+  off_t end = file->ra_next + file->ra_window;
+  if (file->ra_end > start && file->ra_end <= end)
+    start = file->ra_end;
+  if (start < end)
+    {
+      inode_readahead (file->inode, start, end - start);
+      file->ra_end = end;
+    }
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
    starting at the file's current position.
    Returns the number of bytes actually read,
    which may be less than SIZE if end of file is reached.
-   Advances FILE's position by the number of bytes read. */
+   Advances FILE's position by the number of bytes read.
+
+   If FILE is the reading end of a pipe, waits for data and reads
+   what is available, up to SIZE bytes, returning 0 only at end
+   of file.  Returns -1 for the writing end. */
 off_t
 file_read (struct file *file, void *buffer, off_t size)
 {
+  if (file->pipe != NULL)
+    return (file->write_end ? -1
+            : pipe_read (file->pipe, buffer, size, &file->cancelled));
+
   off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  file_read_done (file, file->pos, bytes_read);
   file->pos += bytes_read;
   return bytes_read;
 }
 
+/* Reads from FILE into the IOVCNT buffers in IOV, in order,
+   starting at the file's current position, as one operation.
+   Returns the number of bytes actually read, which may be less
+   than the total size of the buffers if end of file is reached.
+   Advances FILE's position by the number of bytes read.
+
+   For the reading end of a pipe, stops at the first buffer that
+   is not filled completely. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, int iovcnt)
+{
+  off_t bytes_read = 0;
+  int i;
+
+  if (file->pipe == NULL)
+    {
+      bytes_read = inode_readv_at (file->inode, iov, iovcnt, file->pos);
+      file_read_done (file, file->pos, bytes_read);
+      file->pos += bytes_read;
+      return bytes_read;
+    }
+
+  for (i = 0; i < iovcnt; i++)
+    {
+      off_t n = file_read (file, iov[i].iov_base, iov[i].iov_len);
+      if (n < 0)
+        return bytes_read > 0 ? bytes_read : -1;
+      bytes_read += n;
+      if (n < (off_t) iov[i].iov_len)
+        break;
+    }
+  return bytes_read;
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually read,
    which may be less than SIZE if end of file is reached.
-   The file's current position is unaffected. */
+   The file's current position is unaffected.
+   Returns -1 for a pipe end, which has no offsets. */
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 {
-  return inode_read_at (file->inode, buffer, size, file_ofs);
+  if (file->pipe != NULL)
+    return -1;
+
+  off_t bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+  file_read_done (file, file_ofs, bytes_read);
+  return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
@@ -90,10 +263,18 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
    which may be less than SIZE if end of file is reached.
    (Normally we'd grow the file in that case, but file growth is
    not yet implemented.)
-   Advances FILE's position by the number of bytes read. */
+   Advances FILE's position by the number of bytes read.
+
+   If FILE is the writing end of a pipe, waits for room as needed
+   and returns -1 if the pipe has no reading end.  Returns -1 for
+   the reading end. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size)
 {
+  if (file->pipe != NULL)
+    return (file->write_end
+            ? pipe_write (file->pipe, buffer, size, &file->cancelled) : -1);
+
   /* A directory should not be written to by file methods. */
   if (inode_is_dir (file_get_inode (file)))
       return -1;
@@ -103,27 +284,142 @@ file_write (struct file *file, const void *buffer, off_t size)
   return bytes_written;
 }
 
+/* Writes the IOVCNT buffers in IOV, in order, into FILE,
+   starting at the file's current position, as one operation.
+   Returns the number of bytes actually written, which may be less
+   than the total size of the buffers if an error occurs.
+   Advances FILE's position by the number of bytes written. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, int iovcnt)
+{
+  off_t bytes_written = 0;
+  int i;
+
+  if (file->pipe == NULL)
+    {
+      if (inode_is_dir (file->inode))
+        return -1;
+      bytes_written = inode_writev_at (file->inode, iov, iovcnt, file->pos);
+      file->pos += bytes_written;
+      return bytes_written;
+    }
+
+  for (i = 0; i < iovcnt; i++)
+    {
+      off_t n = file_write (file, iov[i].iov_base, iov[i].iov_len);
+      if (n < 0)
+        return bytes_written > 0 ? bytes_written : -1;
+      bytes_written += n;
+      if (n < (off_t) iov[i].iov_len)
+        break;
+    }
+  return bytes_written;
+}
+
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
    which may be less than SIZE if end of file is reached.
    (Normally we'd grow the file in that case, but file growth is
    not yet implemented.)
-   The file's current position is unaffected. */
+   The file's current position is unaffected.
+   Returns -1 for a pipe end, which has no offsets. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
                off_t file_ofs)
 {
+  if (file->pipe != NULL)
+    return -1;
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Copies up to SIZE bytes from IN, starting at its current
+   position, to OUT, starting at its current position, without
+   leaving the kernel.  Returns the number of bytes copied, which
+   may be less than SIZE if end of IN is reached, and advances
+   both positions by that much.  Returns -1 if either file is a
+   pipe end or a directory, if IN and OUT are the same file and
+   the ranges overlap, or if nothing could be copied short of end
+   of IN. */
+off_t
+file_copy (struct file *out, struct file *in, off_t size)
+{
+  off_t bytes_copied;
+
+  if (in->pipe != NULL || out->pipe != NULL
+      || inode_is_dir (in->inode) || inode_is_dir (out->inode))
+    return -1;
+
+  bytes_copied = inode_copy_at (out->inode, out->pos, in->inode, in->pos,
+                                size);
+  if (bytes_copied > 0)
+    {
+      in->pos += bytes_copied;
+      out->pos += bytes_copied;
+    }
+  return bytes_copied;
+}
+
+/* Writes FILE's dirty blocks back to disk, together with its
+   metadata unless DATA_ONLY is true and the file has not grown.
+   Returns false if FILE is a pipe end, which has nothing on
+   disk. */
+bool
+file_sync (struct file *file, bool data_only)
+{
+  ASSERT (file != NULL);
+  if (file->pipe != NULL)
+    return false;
+  inode_sync (file->inode, data_only);
+  return true;
+}
+
+/* Gives ADVICE, one of the POSIX_FADV_* access patterns, for the
+   LEN bytes of FILE starting at OFFSET, or through end of file if
+   LEN is 0.  POSIX_FADV_WILLNEED starts reading the range into
+   the cache in the background, but the cache takes only so many
+   read-ahead loads at once (READAHEAD_LOADS_MAX in cache.c), so
+   the part of a larger range past that is skipped and read on
+   demand instead.  POSIX_FADV_DONTNEED writes the range back and
+   evicts it.  The other patterns ignore the range and apply to
+   all later reads through FILE.  Returns false if FILE is a pipe
+   end or ADVICE is unknown. */
+bool
+file_advise (struct file *file, off_t offset, off_t len, int advice)
+{
+  ASSERT (file != NULL);
+  if (file->pipe != NULL)
+    return false;
+
+  if (len == 0)
+    len = inode_length (file->inode) - offset;
+
+  switch (advice)
+    {
+    case POSIX_FADV_NORMAL:
+    case POSIX_FADV_RANDOM:
+    case POSIX_FADV_SEQUENTIAL:
+    case POSIX_FADV_NOREUSE:
+      file->advice = advice;
+      return true;
+    case POSIX_FADV_WILLNEED:
+      inode_readahead (file->inode, offset, len);
+      return true;
+    case POSIX_FADV_DONTNEED:
+      inode_uncache (file->inode, offset, len, true);
+      return true;
+    default:
+      return false;
+    }
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
 file_deny_write (struct file *file)
 {
   ASSERT (file != NULL);
-  if (!file->deny_write)
+  if (!file->deny_write && file->pipe == NULL)
     {
       file->deny_write = true;
       inode_deny_write (file->inode);
@@ -144,11 +440,13 @@ file_allow_write (struct file *file)
     }
 }
 
-/* Returns the size of FILE in bytes. */
+/* Returns the size of FILE in bytes, or 0 for a pipe end. */
 off_t
 file_length (struct file *file)
 {
   ASSERT (file != NULL);
+  if (file->pipe != NULL)
+    return 0;
   return inode_length (file->inode);
 }
 
@@ -175,19 +473,21 @@ file_tell (struct file *file)
    file or a directory.
 
    In Pintos, the sector number of the inode is suitable for use as
-   an inode number.*/
+   an inode number.  Returns -1 for a pipe end. */
 int
 file_inumber (struct file *file)
 {
   ASSERT (file != NULL);
+  if (file->pipe != NULL)
+    return -1;
   return inode_get_inumber (file->inode);
 }
 
 /* Returns true if FILE is a directory, false if it represents an
-   ordinary file. */
+   ordinary file or a pipe end. */
 bool
 file_is_dir (struct file *file)
 {
   ASSERT (file != NULL);
-  return inode_is_dir (file->inode);
+  return file->pipe == NULL && inode_is_dir (file->inode);
 }
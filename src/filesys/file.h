@@ -3,23 +3,36 @@
 
 #include <stdbool.h>
 #include "filesys/off_t.h"
+#include <uio.h>
 
 struct inode;
 
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
+bool file_open_pipe (struct file **read_end, struct file **write_end);
 struct file *file_reopen (struct file *);
 void file_close (struct file *);
 struct inode *file_get_inode (struct file *);
 int file_inumber (struct file *file);
 bool file_is_dir (struct file *file);
+bool file_is_pipe (struct file *file);
+void file_cancel (struct file *);
 
 /* Reading and writing. */
 off_t file_read (struct file *, void *, off_t);
+off_t file_readv (struct file *, const struct iovec *, int iovcnt);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
+off_t file_writev (struct file *, const struct iovec *, int iovcnt);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
 
+/* Copying between files. */
+off_t file_copy (struct file *out, struct file *in, off_t size);
+bool file_sync (struct file *, bool data_only);
+
+/* Access pattern advice. */
+bool file_advise (struct file *, off_t offset, off_t len, int advice);
+
 /* Preventing writes. */
 void file_deny_write (struct file *);
 void file_allow_write (struct file *);
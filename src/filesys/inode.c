@@ -63,6 +63,7 @@ struct inode
 
   struct lock inode_lock; /* Lock of inode. */
   bool last_read;         /* Whether the last access is read or not. */
+  bool grown;             /* Grown since the last inode_sync()? */
 };
 
 /* inode_disk calculation functions. */
@@ -176,11 +177,13 @@ inode_disk_byte_to_sector (const struct inode_disk *inode_disk, off_t pos)
   return sector;
 }
 
-/* Create an empty inode structure with depth of DEPTH at SECTOR.
+/* Create an empty inode structure with depth of DEPTH at SECTOR,
+   belonging to the inode at sector OWNER.
    When IS_DIR is true, the inode is a directory.
    Returns true if successful, false on failure. */
 static bool
-inode_create_empty (block_sector_t sector, uint32_t depth, bool is_dir)
+inode_create_empty (block_sector_t sector, uint32_t depth, bool is_dir,
+                    block_sector_t owner)
 {
   struct inode_disk *disk_inode = NULL;
 
@@ -197,7 +200,7 @@ inode_create_empty (block_sector_t sector, uint32_t depth, bool is_dir)
   disk_inode->depth = depth;
   disk_inode->magic = INODE_MAGIC;
 
-  filesys_block_write (sector, disk_inode);
+  filesys_block_write (sector, disk_inode, owner);
   free (disk_inode);
 
   return true;
@@ -206,20 +209,23 @@ inode_create_empty (block_sector_t sector, uint32_t depth, bool is_dir)
 /* Grow functions for inode. */
 
 static bool inode_disk_grow_length_direct (struct inode_disk *disk_inode,
-                                           off_t size, bool zero);
+                                           off_t size, bool zero,
+                                           block_sector_t owner);
 static bool inode_disk_grow_length (struct inode_disk *disk_inode,
-                                    off_t length, bool zero);
+                                    off_t length, bool zero,
+                                    block_sector_t owner);
 static bool inode_grow_depth (struct inode *inode, size_t depth);
 
 static bool sector_grow_length (block_sector_t sector, off_t length,
-                                bool zero);
+                                bool zero, block_sector_t owner);
 
 /* Grow the length of the direct inode DISK_INODE to SIZE bytes.
-   If ZERO is true, zero the new space.
+   If ZERO is true, zero the new space.  New blocks belong to the
+   inode at sector OWNER.
    Returns true if successful, false on failure. */
 static bool
 inode_disk_grow_length_direct (struct inode_disk *disk_inode, off_t size,
-                               bool zero)
+                               bool zero, block_sector_t owner)
 {
   ASSERT (disk_inode != NULL);
   ASSERT (disk_inode->depth == 0);
@@ -245,7 +251,7 @@ inode_disk_grow_length_direct (struct inode_disk *disk_inode, off_t size,
       if (zero)
         {
           static char zeros[BLOCK_SECTOR_SIZE];
-          filesys_block_write (disk_inode->blocks[i], zeros);
+          filesys_block_write (disk_inode->blocks[i], zeros, owner);
         }
     }
 
@@ -289,7 +295,7 @@ inode_grow_depth (struct inode *inode, size_t depth)
   /* Write the old block to new sector. */
   if (!free_map_allocate (1, &sector))
     return false;
-  filesys_block_write (sector, &disk_inode);
+  filesys_block_write (sector, &disk_inode, inode->sector);
 
   /* Set all the new indirect blocks to 0. */
   for (size_t i = 0; i < INODE_BLOCK_COUNT; i++)
@@ -309,7 +315,7 @@ inode_grow_depth (struct inode *inode, size_t depth)
         return false;
 
       /* Write the new block to the inode. */
-      filesys_block_write (sector, &disk_inode);
+      filesys_block_write (sector, &disk_inode, inode->sector);
 
       /* Increase the depth of the inode. */
       disk_inode.depth++;
@@ -320,21 +326,23 @@ inode_grow_depth (struct inode *inode, size_t depth)
 
   /* The last block should be saved to the original inode. */
   inode->data = disk_inode;
-  filesys_block_write (inode->sector, &inode->data);
+  filesys_block_write (inode->sector, &inode->data, inode->sector);
 
   return true;
 }
 
 /* Grow the length of the inode DISK_INODE to SIZE bytes.
-   If ZERO is true, zero the new space.
+   If ZERO is true, zero the new space.  New blocks belong to the
+   inode at sector OWNER.
    Returns true if successful, false on failure. */
 static bool
-inode_disk_grow_length (struct inode_disk *disk_inode, off_t length, bool zero)
+inode_disk_grow_length (struct inode_disk *disk_inode, off_t length, bool zero,
+                        block_sector_t owner)
 {
   ASSERT (disk_inode != NULL);
 
   if (disk_inode->depth == 0)
-    return inode_disk_grow_length_direct (disk_inode, length, zero);
+    return inode_disk_grow_length_direct (disk_inode, length, zero, owner);
   if (length < disk_inode->length)
     return false;
   if (length == disk_inode->length)
@@ -370,13 +378,13 @@ inode_disk_grow_length (struct inode_disk *disk_inode, off_t length, bool zero)
 
           last_allocated = true;
           if (!inode_create_empty (disk_inode->blocks[block_index],
-                                   disk_inode->depth - 1, false))
+                                   disk_inode->depth - 1, false, owner))
             break;
         }
 
       /* Recursively grow the indirect block. */
       if (!sector_grow_length (disk_inode->blocks[block_index],
-                               new_block_length, zero))
+                               new_block_length, zero, owner))
         break;
 
       /* Update length of the inode. */
@@ -398,10 +406,12 @@ inode_disk_grow_length (struct inode_disk *disk_inode, off_t length, bool zero)
 }
 
 /* Grow the length of inode at sector SECTOR to LENGTH bytes.
-   If ZERO is true, zero the new space.
+   If ZERO is true, zero the new space.  SECTOR and new blocks
+   belong to the inode at sector OWNER.
    Returns true if successful, false on failure. */
 static bool
-sector_grow_length (block_sector_t sector, off_t length, bool zero)
+sector_grow_length (block_sector_t sector, off_t length, bool zero,
+                    block_sector_t owner)
 {
   struct inode_disk *disk_inode = NULL;
 
@@ -410,9 +420,9 @@ sector_grow_length (block_sector_t sector, off_t length, bool zero)
     return false;
   filesys_block_read (sector, disk_inode);
 
-  bool success = inode_disk_grow_length (disk_inode, length, zero);
+  bool success = inode_disk_grow_length (disk_inode, length, zero, owner);
 
-  filesys_block_write (sector, disk_inode);
+  filesys_block_write (sector, disk_inode, owner);
   free (disk_inode);
 
   return success;
@@ -424,8 +434,9 @@ sector_grow_length (block_sector_t sector, off_t length, bool zero)
 static bool
 inode_grow_length (struct inode *inode, off_t length, bool zero)
 {
-  bool success = inode_disk_grow_length (&inode->data, length, zero);
-  filesys_block_write (inode->sector, &inode->data);
+  bool success = inode_disk_grow_length (&inode->data, length, zero,
+                                         inode->sector);
+  filesys_block_write (inode->sector, &inode->data, inode->sector);
   return success;
 }
 
@@ -468,9 +479,9 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
   uint32_t depth = bytes_to_depth (length);
-  if (!inode_create_empty (sector, depth, is_dir))
+  if (!inode_create_empty (sector, depth, is_dir, sector))
     return false;
-  if (!sector_grow_length (sector, length, true))
+  if (!sector_grow_length (sector, length, true, sector))
     return false;
   return true;
 }
@@ -509,6 +520,7 @@ inode_open (block_sector_t sector)
   inode->removed = false;
   inode->last_read = false;
   lock_init (&inode->inode_lock);
+  inode->grown = false;
   filesys_block_read (inode->sector, &inode->data);
   return inode;
 }
@@ -726,13 +738,42 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   return read_bytes;
 }
 
+/* Reads from INODE into the IOVCNT buffers in IOV, in order,
+   starting at position OFFSET, all under one acquisition of the
+   inode's lock.  Returns the number of bytes actually read, which
+   may be less than the total size of the buffers if an error
+   occurs or end of file is reached. */
+off_t
+inode_readv_at (struct inode *inode, const struct iovec *iov, int iovcnt,
+                off_t offset)
+{
+  off_t read_bytes = 0;
+  int i;
+
+  if (inode->last_read)
+    thread_yield ();
+
+  lock_acquire (&inode->inode_lock);
+  for (i = 0; i < iovcnt; i++)
+    {
+      off_t n = inode_disk_read_at (&inode->data, iov[i].iov_base,
+                                    iov[i].iov_len, offset + read_bytes);
+      read_bytes += n;
+      if (n < (off_t) iov[i].iov_len)
+        break;
+    }
+  inode->last_read = true;
+  lock_release (&inode->inode_lock);
+  return read_bytes;
+}
+
 /* Writes SIZE bytes from BUFFER into direct disk inode INODE_DISK,
-   starting at OFFSET.
+   which belongs to the inode at sector OWNER, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs. */
 static off_t
 inode_disk_write_at_direct (struct inode_disk *inode_disk, const void *buffer_,
-                            off_t size, off_t offset)
+                            off_t size, off_t offset, block_sector_t owner)
 {
   ASSERT (inode_disk->depth == 0);
 
@@ -762,13 +803,13 @@ inode_disk_write_at_direct (struct inode_disk *inode_disk, const void *buffer_,
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
           /* Write full sector to disk. */
-          filesys_block_write (sector_idx, buffer + bytes_written);
+          filesys_block_write (sector_idx, buffer + bytes_written, owner);
         }
       else
         {
           /* Write bytes to disk. */
           filesys_block_write_bytes (sector_idx, buffer + bytes_written,
-                                     sector_ofs, chunk_size);
+                                     sector_ofs, chunk_size, owner);
         }
 
       /* Advance. */
@@ -780,16 +821,17 @@ inode_disk_write_at_direct (struct inode_disk *inode_disk, const void *buffer_,
   return bytes_written;
 }
 
-/* Writes SIZE bytes from BUFFER into disk inode INODE_DISK, starting
-   at OFFSET.
+/* Writes SIZE bytes from BUFFER into disk inode INODE_DISK, which
+   belongs to the inode at sector OWNER, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs. */
 static off_t
 inode_disk_write_at (struct inode_disk *inode_disk, const void *buffer_,
-                     off_t size, off_t offset)
+                     off_t size, off_t offset, block_sector_t owner)
 {
   if (inode_disk->depth == 0)
-    return inode_disk_write_at_direct (inode_disk, buffer_, size, offset);
+    return inode_disk_write_at_direct (inode_disk, buffer_, size, offset,
+                                       owner);
 
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
@@ -825,7 +867,7 @@ inode_disk_write_at (struct inode_disk *inode_disk, const void *buffer_,
                           indirect_disk_inode);
       write_size
           = inode_disk_write_at (indirect_disk_inode, buffer + bytes_written,
-                                 write_size, block_offset);
+                                 write_size, block_offset, owner);
 
       /* Advance. */
       size -= write_size;
@@ -838,6 +880,42 @@ inode_disk_write_at (struct inode_disk *inode_disk, const void *buffer_,
   return bytes_written;
 }
 
+/* Makes INODE long enough for a write of the bytes from OFFSET to
+   NEW_LENGTH, zero-filling any gap between its current end and
+   OFFSET.  Returns true if successful, false if disk space runs
+   out.  The caller must hold INODE's lock. */
+static bool
+inode_reserve (struct inode *inode, off_t offset, off_t new_length)
+{
+  ASSERT (lock_held_by_current_thread (&inode->inode_lock));
+
+  if (new_length > inode->data.length)
+    inode->grown = true;
+
+  /* Grow depth if necessary. */
+  uint32_t depth = bytes_to_depth (new_length);
+  if (inode->data.depth < depth)
+    {
+      if (!inode_grow_depth (inode, depth))
+        return false;
+    }
+
+  /* Extend length to offset, with zero fill, if necessary. */
+  if (inode->data.length < offset)
+    {
+      if (!inode_grow_length (inode, offset, true))
+        return false;
+    }
+
+  /* Extend length to new_length, without zero fill, if necessary. */
+  if (inode->data.length < new_length)
+    {
+      if (!inode_grow_length (inode, new_length, false))
+        return false;
+    }
+  return true;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    A write at end of file would extend the inode
    Returns the number of bytes actually written, which may be
@@ -856,37 +934,213 @@ inode_write_at (struct inode *inode, const void *buffer, off_t size,
   lock_acquire (&inode->inode_lock);
 
   off_t write_count = 0;
-  off_t new_length = offset + size;
+  if (inode_reserve (inode, offset, offset + size))
+    write_count = inode_disk_write_at (&inode->data, buffer, size, offset,
+                                       inode->sector);
 
-  /* Grow depth if necessary. */
-  uint32_t depth = bytes_to_depth (new_length);
-  if (inode->data.depth < depth)
+  inode->last_read = false;
+  lock_release (&inode->inode_lock);
+  return write_count;
+}
+
+/* Writes the IOVCNT buffers in IOV, in order, into INODE,
+   starting at OFFSET, all under one acquisition of the inode's
+   lock.  The inode is extended once, to fit all of the data.
+   Returns the number of bytes actually written, which may be
+   less than the total size of the buffers if an error occurs. */
+off_t
+inode_writev_at (struct inode *inode, const struct iovec *iov, int iovcnt,
+                 off_t offset)
+{
+  off_t size = 0;
+  int i;
+
+  if (inode->deny_write_cnt)
+    return 0;
+
+  for (i = 0; i < iovcnt; i++)
+    size += iov[i].iov_len;
+
+  if (!inode->last_read)
+    thread_yield ();
+
+  lock_acquire (&inode->inode_lock);
+
+  off_t write_count = 0;
+  if (inode_reserve (inode, offset, offset + size))
+    for (i = 0; i < iovcnt; i++)
+      {
+        off_t n = inode_disk_write_at (&inode->data, iov[i].iov_base,
+                                       iov[i].iov_len, offset + write_count,
+                                       inode->sector);
+        write_count += n;
+        if (n < (off_t) iov[i].iov_len)
+          break;
+      }
+
+  inode->last_read = false;
+  lock_release (&inode->inode_lock);
+  return write_count;
+}
+
+/* Copies up to SIZE bytes from SRC, starting at SRC_OFS, into
+   DST, starting at DST_OFS, extending DST as needed.  Whole
+   sectors at the same alignment in both inodes are copied cache
+   block to cache block; the ragged parts go through a bounce
+   buffer of one sector.  Returns the number of bytes copied,
+   which is 0 only at end of SRC and otherwise less than SIZE if
+   end of SRC is reached or an error occurs partway.  Returns -1
+   if SRC and DST are the same inode and the ranges, cut off at
+   end of SRC, overlap, or if nothing could be copied because DST
+   is write-denied, memory is short, or the disk is full. */
+off_t
+inode_copy_at (struct inode *dst, off_t dst_ofs, struct inode *src,
+               off_t src_ofs, off_t size)
+{
+  struct inode *first, *second;
+  uint8_t *bounce = malloc (BLOCK_SECTOR_SIZE);
+  off_t copied = 0;
+
+  /* Lock in order of sector number, to avoid deadlock with a copy
+     the other way. */
+  first = dst->sector < src->sector ? dst : src;
+  second = first == dst ? src : dst;
+  lock_acquire (&first->inode_lock);
+  if (second != first)
+    lock_acquire (&second->inode_lock);
+
+  if (src->data.length - src_ofs < size)
+    size = src->data.length - src_ofs;
+  if (size <= 0)
+    goto done;
+
+  /* Both offsets are nonnegative, so neither difference can
+     overflow, unlike DST_OFS + SIZE. */
+  if (dst == src && src_ofs - dst_ofs < size && dst_ofs - src_ofs < size)
     {
-      if (!inode_grow_depth (inode, depth))
-        goto done;
+      copied = -1;
+      goto done;
     }
 
-  /* Extend length to offset, with zero fill, if necessary. */
-  if (inode->data.length < offset)
+  if (!dst->deny_write_cnt && bounce != NULL
+      && inode_reserve (dst, dst_ofs, dst_ofs + size))
+    while (copied < size)
+      {
+        off_t s = src_ofs + copied;
+        off_t d = dst_ofs + copied;
+        off_t left = size - copied;
+
+        if (s % BLOCK_SECTOR_SIZE == 0 && d % BLOCK_SECTOR_SIZE == 0
+            && left >= BLOCK_SECTOR_SIZE)
+          {
+            block_sector_t src_sector
+                = inode_disk_byte_to_sector (&src->data, s);
+            block_sector_t dst_sector
+                = inode_disk_byte_to_sector (&dst->data, d);
+            if (src_sector == (block_sector_t)-1
+                || dst_sector == (block_sector_t)-1)
+              break;
+            filesys_block_copy (dst_sector, src_sector, dst->sector);
+            copied += BLOCK_SECTOR_SIZE;
+          }
+        else
+          {
+            off_t chunk = BLOCK_SECTOR_SIZE - s % BLOCK_SECTOR_SIZE;
+            if (chunk > BLOCK_SECTOR_SIZE - d % BLOCK_SECTOR_SIZE)
+              chunk = BLOCK_SECTOR_SIZE - d % BLOCK_SECTOR_SIZE;
+            if (chunk > left)
+              chunk = left;
+
+            off_t n = inode_disk_read_at (&src->data, bounce, chunk, s);
+            if (n > 0)
+              n = inode_disk_write_at (&dst->data, bounce, n, d,
+                                       dst->sector);
+            if (n <= 0)
+              break;
+            copied += n;
+            if (n < chunk)
+              break;
+          }
+      }
+  if (copied == 0)
+    copied = -1;
+  src->last_read = true;
+  dst->last_read = false;
+
+ done:
+  if (second != first)
+    lock_release (&second->inode_lock);
+  lock_release (&first->inode_lock);
+  free (bounce);
+  return copied;
+}
+
+/* Writes INODE's dirty data blocks and indirect blocks back to
+   disk, without touching other files' blocks in the cache.  Also
+   writes back INODE's own sector, and the free map, if INODE has
+   grown since the last call, or always unless DATA_ONLY is true.
+   So with DATA_ONLY, unchanged metadata such as a file's
+   unchanged length is not written. */
+void
+inode_sync (struct inode *inode, bool data_only)
+{
+  lock_acquire (&inode->inode_lock);
+  filesys_sync_owner (inode->sector, !data_only || inode->grown);
+  if (inode->grown)
     {
-      if (!inode_grow_length (inode, offset, true))
-        goto done;
+      /* The blocks the inode grew into are marked used in the
+         free map. */
+      filesys_sync_owner (FREE_MAP_SECTOR, true);
+      inode->grown = false;
     }
+  lock_release (&inode->inode_lock);
+}
 
-  /* Extend length to new_length, without zero fill, if necessary. */
-  if (inode->data.length < new_length)
+/* Calls FUNC on the sector of each block of INODE that holds
+   part of the SIZE bytes starting at OFFSET, stopping at end of
+   file. */
+static void
+inode_for_each_sector (struct inode *inode, off_t offset, off_t size,
+                       void (*func) (block_sector_t))
+{
+  lock_acquire (&inode->inode_lock);
+
+  off_t length = inode->data.length;
+  if (offset < length)
     {
-      if (!inode_grow_length (inode, new_length, false))
-        goto done;
-    }
+      if (size > length - offset)
+        size = length - offset;
 
-  /* Actually write. */
-  write_count = inode_disk_write_at (&inode->data, buffer, size, offset);
+      for (off_t pos = ROUND_DOWN (offset, BLOCK_SECTOR_SIZE);
+           pos < offset + size; pos += BLOCK_SECTOR_SIZE)
+        {
+          block_sector_t sector = inode_byte_to_sector (inode, pos);
+          if (sector == (block_sector_t)-1)
+            break;
+          func (sector);
+        }
+    }
 
-done:
-  inode->last_read = false;
   lock_release (&inode->inode_lock);
-  return write_count;
+}
+
+/* Starts reading the SIZE bytes of INODE at OFFSET into the
+   buffer cache in the background, following INODE's own block
+   mapping. */
+void
+inode_readahead (struct inode *inode, off_t offset, off_t size)
+{
+  inode_for_each_sector (inode, offset, size, filesys_readahead);
+}
+
+/* Evicts the SIZE bytes of INODE at OFFSET from the buffer cache
+   if DROP is true, writing back dirty blocks first, or otherwise
+   just makes them the first candidates for eviction. */
+void
+inode_uncache (struct inode *inode, off_t offset, off_t size, bool drop)
+{
+  inode_for_each_sector (inode, offset, size,
+                         drop ? filesys_cache_drop : filesys_cache_demote);
 }
 
 /* Disables writes to INODE.
@@ -4,6 +4,7 @@
 #include "devices/block.h"
 #include "filesys/off_t.h"
 #include <stdbool.h>
+#include <uio.h>
 
 struct bitmap;
 
@@ -16,6 +17,15 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_readv_at (struct inode *, const struct iovec *, int iovcnt,
+                      off_t offset);
+off_t inode_writev_at (struct inode *, const struct iovec *, int iovcnt,
+                       off_t offset);
+off_t inode_copy_at (struct inode *dst, off_t dst_ofs, struct inode *src,
+                     off_t src_ofs, off_t size);
+void inode_sync (struct inode *, bool data_only);
+void inode_readahead (struct inode *, off_t offset, off_t size);
+void inode_uncache (struct inode *, off_t offset, off_t size, bool drop);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
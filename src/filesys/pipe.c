@@ -0,0 +1,188 @@
+#include "filesys/pipe.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Number of bytes a pipe buffers, one page. */
+#define PIPE_SIZE PGSIZE
+
+/* A pipe: a ring buffer in kernel memory with a reading end and a
+   writing end, each of which may be open any number of times.
+   Reads block while the pipe is empty and writes while it is
+   full.  Once every writing end is closed, reads of an empty pipe
+   return 0, for end of file; once every reading end is closed,
+   writes fail.  The pipe is freed when both ends are closed. */
+struct pipe
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition not_empty; /* Signaled when data is written. */
+    struct condition not_full;  /* Signaled when data is read. */
+    uint8_t *buffer;            /* PIPE_SIZE bytes of data. */
+    size_t head;                /* Index of the first byte to read. */
+    size_t used;                /* Number of bytes in BUFFER. */
+    unsigned readers;           /* Number of open reading ends. */
+    unsigned writers;           /* Number of open writing ends. */
+  };
+
+/* Creates and returns a new pipe with neither end open, or a null
+   pointer if memory is short.  The pipe is freed once both ends
+   have been opened with pipe_open() and closed again. */
+struct pipe *
+pipe_create (void)
+{
+  struct pipe *p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+
+  p->buffer = palloc_get_page (0);
+  if (p->buffer == NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  lock_init (&p->lock);
+  cond_init (&p->not_empty);
+  cond_init (&p->not_full);
+  p->head = p->used = 0;
+  p->readers = p->writers = 0;
+  return p;
+}
+
+/* Opens another reading or writing end of P, according to
+   WRITE_END. */
+void
+pipe_open (struct pipe *p, bool write_end)
+{
+  lock_acquire (&p->lock);
+  if (write_end)
+    p->writers++;
+  else
+    p->readers++;
+  lock_release (&p->lock);
+}
+
+/* Closes a reading or writing end of P, according to WRITE_END,
+   and frees P if that was the last end open. */
+void
+pipe_close (struct pipe *p, bool write_end)
+{
+  bool last;
+
+  lock_acquire (&p->lock);
+  if (write_end)
+    {
+      ASSERT (p->writers > 0);
+      p->writers--;
+    }
+  else
+    {
+      ASSERT (p->readers > 0);
+      p->readers--;
+    }
+
+  /* Wake up anyone waiting for the other end. */
+  cond_broadcast (&p->not_empty, &p->lock);
+  cond_broadcast (&p->not_full, &p->lock);
+  last = p->readers == 0 && p->writers == 0;
+  lock_release (&p->lock);
+
+  if (last)
+    {
+      palloc_free_page (p->buffer);
+      free (p);
+    }
+}
+
+/* Reads up to SIZE bytes from P into BUFFER.  Waits until P holds
+   at least one byte or has no writing end open, then reads what is
+   there.  Returns the number of bytes read, which is 0 only at end
+   of file, or if *CANCEL is set by pipe_cancel() first. */
+off_t
+pipe_read (struct pipe *p, void *buffer_, off_t size, const bool *cancel)
+{
+  uint8_t *buffer = buffer_;
+  size_t bytes_read = 0;
+
+  if (size <= 0)
+    return 0;
+
+  lock_acquire (&p->lock);
+  while (p->used == 0 && p->writers > 0 && !*cancel)
+    cond_wait (&p->not_empty, &p->lock);
+
+  while (bytes_read < (size_t) size && p->used > 0)
+    {
+      size_t chunk = PIPE_SIZE - p->head;
+      if (chunk > p->used)
+        chunk = p->used;
+      if (chunk > size - bytes_read)
+        chunk = size - bytes_read;
+
+      memcpy (buffer + bytes_read, p->buffer + p->head, chunk);
+      p->head = (p->head + chunk) % PIPE_SIZE;
+      p->used -= chunk;
+      bytes_read += chunk;
+    }
+  if (bytes_read > 0)
+    cond_broadcast (&p->not_full, &p->lock);
+  lock_release (&p->lock);
+
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into P, waiting for room as
+   needed.  Returns the number of bytes written, which is less
+   than SIZE only if every reading end is closed or *CANCEL is
+   set by pipe_cancel() first, or -1 if nothing was written. */
+off_t
+pipe_write (struct pipe *p, const void *buffer_, off_t size,
+            const bool *cancel)
+{
+  const uint8_t *buffer = buffer_;
+  size_t bytes_written = 0;
+
+  if (size <= 0)
+    return 0;
+
+  lock_acquire (&p->lock);
+  while (bytes_written < (size_t) size && p->readers > 0 && !*cancel)
+    {
+      size_t tail, chunk;
+
+      if (p->used == PIPE_SIZE)
+        {
+          cond_wait (&p->not_full, &p->lock);
+          continue;
+        }
+
+      tail = (p->head + p->used) % PIPE_SIZE;
+      chunk = PIPE_SIZE - p->used;
+      if (chunk > PIPE_SIZE - tail)
+        chunk = PIPE_SIZE - tail;
+      if (chunk > size - bytes_written)
+        chunk = size - bytes_written;
+
+      memcpy (p->buffer + tail, buffer + bytes_written, chunk);
+      p->used += chunk;
+      bytes_written += chunk;
+      cond_broadcast (&p->not_empty, &p->lock);
+    }
+  lock_release (&p->lock);
+
+  return bytes_written > 0 ? (off_t) bytes_written : -1;
+}
+/* Sets *CANCEL, making the pipe_read() or pipe_write() on P that
+   was passed CANCEL return at once, whether it is waiting now or
+   starts later. */
+void
+pipe_cancel (struct pipe *p, bool *cancel)
+{
+  lock_acquire (&p->lock);
+  *cancel = true;
+  cond_broadcast (&p->not_empty, &p->lock);
+  cond_broadcast (&p->not_full, &p->lock);
+  lock_release (&p->lock);
+}
@@ -0,0 +1,16 @@
+#ifndef FILESYS_PIPE_H
+#define FILESYS_PIPE_H
+
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+struct pipe;
+
+struct pipe *pipe_create (void);
+void pipe_open (struct pipe *, bool write_end);
+void pipe_close (struct pipe *, bool write_end);
+off_t pipe_read (struct pipe *, void *, off_t, const bool *cancel);
+off_t pipe_write (struct pipe *, const void *, off_t, const bool *cancel);
+void pipe_cancel (struct pipe *, bool *cancel);
+
+#endif /* filesys/pipe.h */
@@ -0,0 +1,61 @@
+#ifndef __LIB_AIO_RING_H
+#define __LIB_AIO_RING_H
+
+#include <stdint.h>
+
+/* Asynchronous I/O rings, shared between a user process and the
+   kernel.
+
+   aio_setup() maps one page holding a struct aio_ring into the
+   calling process.  The process queues requests by filling in
+   sq[sq_tail % AIO_RING_ENTRIES] and then incrementing sq_tail,
+   and passes them to the kernel with aio_enter().  The kernel
+   posts a completion for each request at cq[cq_tail %
+   AIO_RING_ENTRIES] and increments cq_tail; the process consumes
+   completions by incrementing cq_head.  Each index is written by
+   one side only and only ever increases, wrapping around at
+   2**32. */
+
+/* Number of entries in each ring. */
+#define AIO_RING_ENTRIES 64
+
+/* Request types. */
+enum aio_opcode
+  {
+    AIO_READ,                   /* Read LEN bytes at OFFSET into BUF. */
+    AIO_WRITE,                  /* Write LEN bytes from BUF at OFFSET. */
+    AIO_OPEN,                   /* Open the file named BUF; RES is the fd. */
+    AIO_CLOSE,                  /* Close FD. */
+    AIO_FSYNC                   /* Write FD's data to disk. */
+  };
+
+/* A submission queue entry: one request. */
+struct aio_sqe
+  {
+    uint32_t opcode;            /* An enum aio_opcode. */
+    int32_t fd;                 /* File descriptor. */
+    void *buf;                  /* Buffer or file name. */
+    uint32_t len;               /* Number of bytes to transfer. */
+    int32_t offset;             /* File offset, ignored for pipes. */
+    uint32_t user_data;         /* Copied into the completion. */
+  };
+
+/* A completion queue entry: the result of one request. */
+struct aio_cqe
+  {
+    uint32_t user_data;         /* From the request. */
+    int32_t res;                /* Result, as for the blocking call. */
+  };
+
+/* A pair of rings. */
+struct aio_ring
+  {
+    volatile uint32_t sq_head;  /* Next request to take (kernel). */
+    volatile uint32_t sq_tail;  /* Next free request slot (user). */
+    volatile uint32_t cq_head;  /* Next completion to reap (user). */
+    volatile uint32_t cq_tail;  /* Next free completion slot (kernel). */
+    struct aio_sqe sq[AIO_RING_ENTRIES];
+    struct aio_cqe cq[AIO_RING_ENTRIES];
+  };
+
+#endif /* lib/aio-ring.h */
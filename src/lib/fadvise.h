@@ -0,0 +1,15 @@
+#ifndef __LIB_FADVISE_H
+#define __LIB_FADVISE_H
+
+/* Access pattern advice for fadvise(). */
+enum
+  {
+    POSIX_FADV_NORMAL,          /* No advice, the default. */
+    POSIX_FADV_RANDOM,          /* Reads are random: no read-ahead. */
+    POSIX_FADV_SEQUENTIAL,      /* Reads are sequential: read far ahead. */
+    POSIX_FADV_WILLNEED,        /* Range is needed soon: prefetch it. */
+    POSIX_FADV_DONTNEED,        /* Range is not needed: drop it. */
+    POSIX_FADV_NOREUSE          /* Data is read once: evict it first. */
+  };
+
+#endif /* lib/fadvise.h */
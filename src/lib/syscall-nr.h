@@ -28,7 +28,24 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_PIPE,                   /* Create a pipe. */
+    SYS_DUP2,                   /* Duplicate a file descriptor. */
+    SYS_SHM_CREATE,             /* Create a shared memory segment. */
+    SYS_SHM_ATTACH,             /* Map a shared memory segment. */
+    SYS_SHM_DETACH,             /* Unmap a shared memory segment. */
+    SYS_AIO_SETUP,              /* Map asynchronous I/O rings. */
+    SYS_AIO_ENTER,              /* Submit and reap asynchronous I/O. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read into several buffers. */
+    SYS_WRITEV,                 /* Write from several buffers. */
+    SYS_COPY_FILE_RANGE,        /* Copy data between files. */
+    SYS_FSYNC,                  /* Write a file's data and metadata. */
+    SYS_FDATASYNC,              /* Write a file's data. */
+    SYS_FADVISE                 /* Give advice on file access. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -1,10 +1,35 @@
+#include <stdbool.h>
+#include <stdint.h>
 #include <syscall.h>
 
 int main (int, char *[]);
 void _start (int argc, char *argv[]);
 
+/* Returns true if the CPU supports SYSENTER and SYSEXIT, which
+   the kernel then sets up for us.  CPUID is unprivileged, so we
+   can ask the CPU directly.  See [IA32-v2a] "CPUID". */
+static bool
+have_sysenter (void)
+{
+  uint32_t before, after, a, b, c, d;
+
+  /* CPUID exists if we can toggle the ID flag in EFLAGS. */
+  asm volatile ("pushfl; popl %0; movl %0, %1; xorl $0x200000, %1; "
+                "pushl %1; popfl; pushfl; popl %1; pushl %0; popfl"
+                : "=&r" (before), "=&r" (after));
+  if (((before ^ after) & 0x200000) == 0)
+    return false;
+
+  asm volatile ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (0));
+  if (a < 1)
+    return false;
+  asm volatile ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (1));
+  return (d & (1u << 11)) != 0;
+}
+
 void
 _start (int argc, char *argv[]) 
 {
+  syscall_use_sysenter = have_sysenter ();
   exit (main (argc, argv));
 }
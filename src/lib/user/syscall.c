@@ -1,31 +1,46 @@
 #include <syscall.h>
 #include "../syscall-nr.h"
 
+/* Whether to enter the kernel with SYSENTER instead of
+   "int $0x30".  Set by _start() if the CPU supports it. */
+bool syscall_use_sysenter;
+
+/* Traps into the kernel, with the system call number and
+   arguments already pushed on the stack.  Uses SYSENTER if
+   syscall_use_sysenter is true, passing the return address in
+   EDX and the stack pointer in ECX as the kernel expects, and
+   "int $0x30" otherwise.  Either way, ECX and EDX are
+   clobbered. */
+#define SYSCALL_TRAP                                     \
+        "cmpb $0, syscall_use_sysenter; je 1f; "         \
+        "movl %%esp, %%ecx; movl $2f, %%edx; sysenter; " \
+        "1: int $0x30; 2: "
+
 /* Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
-#define syscall0(NUMBER)                                        \
-        ({                                                      \
-          int retval;                                           \
-          asm volatile                                          \
-            ("pushl %[number]; int $0x30; addl $4, %%esp"       \
-               : "=a" (retval)                                  \
-               : [number] "i" (NUMBER)                          \
-               : "memory");                                     \
-          retval;                                               \
+#define syscall0(NUMBER)                                       \
+        ({                                                     \
+          int retval;                                          \
+          asm volatile                                         \
+            ("pushl %[number]; " SYSCALL_TRAP "addl $4, %%esp" \
+               : "=a" (retval)                                 \
+               : [number] "i" (NUMBER)                         \
+               : "ecx", "edx", "memory");                      \
+          retval;                                              \
         })
 
 /* Invokes syscall NUMBER, passing argument ARG0, and returns the
    return value as an `int'. */
-#define syscall1(NUMBER, ARG0)                                           \
-        ({                                                               \
-          int retval;                                                    \
-          asm volatile                                                   \
-            ("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp" \
-               : "=a" (retval)                                           \
-               : [number] "i" (NUMBER),                                  \
-                 [arg0] "g" (ARG0)                                       \
-               : "memory");                                              \
-          retval;                                                        \
+#define syscall1(NUMBER, ARG0)                                                \
+        ({                                                                    \
+          int retval;                                                         \
+          asm volatile                                                        \
+            ("pushl %[arg0]; pushl %[number]; " SYSCALL_TRAP "addl $8, %%esp" \
+               : "=a" (retval)                                                \
+               : [number] "i" (NUMBER),                                       \
+                 [arg0] "g" (ARG0)                                            \
+               : "ecx", "edx", "memory");                                     \
+          retval;                                                             \
         })
 
 /* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
@@ -35,12 +50,12 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg1]; pushl %[arg0]; "                   \
-             "pushl %[number]; int $0x30; addl $12, %%esp"      \
+             "pushl %[number]; " SYSCALL_TRAP "addl $12, %%esp" \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "r" (ARG0),                             \
                  [arg1] "r" (ARG1)                              \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
@@ -51,13 +66,34 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "    \
-             "pushl %[number]; int $0x30; addl $16, %%esp"      \
+             "pushl %[number]; " SYSCALL_TRAP "addl $16, %%esp" \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "r" (ARG0),                             \
                  [arg1] "r" (ARG1),                             \
                  [arg2] "r" (ARG2)                              \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                       \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2, and
+   ARG3, and returns the return value as an `int'.  ARG3 is passed
+   through memory because the trap clobbers ECX and EDX and GCC
+   may run out of registers on i386. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; " SYSCALL_TRAP    \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "g" (ARG3)                              \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
@@ -182,3 +218,93 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+pipe (int fds[2])
+{
+  return syscall1 (SYS_PIPE, fds);
+}
+
+int
+dup2 (int oldfd, int newfd)
+{
+  return syscall2 (SYS_DUP2, oldfd, newfd);
+}
+
+int
+shm_create (unsigned size)
+{
+  return syscall1 (SYS_SHM_CREATE, size);
+}
+
+void *
+shm_attach (int id)
+{
+  return (void *) syscall1 (SYS_SHM_ATTACH, id);
+}
+
+bool
+shm_detach (void *addr)
+{
+  return syscall1 (SYS_SHM_DETACH, addr);
+}
+
+struct aio_ring *
+aio_setup (void)
+{
+  return (struct aio_ring *) syscall0 (SYS_AIO_SETUP);
+}
+
+int
+aio_enter (unsigned to_submit, unsigned min_complete)
+{
+  return syscall2 (SYS_AIO_ENTER, to_submit, min_complete);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, int offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, int offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+copy_file_range (int in_fd, int out_fd, unsigned length)
+{
+  return syscall3 (SYS_COPY_FILE_RANGE, in_fd, out_fd, length);
+}
+
+int
+fsync (int fd)
+{
+  return syscall1 (SYS_FSYNC, fd);
+}
+
+int
+fdatasync (int fd)
+{
+  return syscall1 (SYS_FDATASYNC, fd);
+}
+
+int
+fadvise (int fd, int offset, int len, int advice)
+{
+  return syscall4 (SYS_FADVISE, fd, offset, len, advice);
+}
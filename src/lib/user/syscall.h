@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <fadvise.h>
+#include <uio.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -15,10 +17,18 @@ typedef int mapid_t;
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* Asynchronous I/O rings, defined in <aio-ring.h>. */
+struct aio_ring;
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
 
+/* True to enter the kernel with SYSENTER, false to use the
+   slower "int $0x30".  Initialized to whether the CPU supports
+   SYSENTER. */
+extern bool syscall_use_sysenter;
+
 /* Projects 2 and later. */
 void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
@@ -45,4 +55,21 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+bool pipe (int fds[2]);
+int dup2 (int oldfd, int newfd);
+int shm_create (unsigned size);
+void *shm_attach (int id);
+bool shm_detach (void *addr);
+struct aio_ring *aio_setup (void);
+int aio_enter (unsigned to_submit, unsigned min_complete);
+int pread (int fd, void *buffer, unsigned length, int offset);
+int pwrite (int fd, const void *buffer, unsigned length, int offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int copy_file_range (int in_fd, int out_fd, unsigned length);
+int fsync (int fd);
+int fdatasync (int fd);
+int fadvise (int fd, int offset, int len, int advice);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,33 @@
+/* Submits asynchronous reads and writes on a directory.  Both
+   must complete with -1 rather than expose or overwrite the raw
+   directory entries. */
+
+#include <syscall.h>
+#include "tests/userprog/ring.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[64];
+
+void
+test_main (void) 
+{
+  struct aio_ring *ring;
+  struct aio_cqe cqe;
+  int fd, i;
+
+  CHECK ((ring = aio_setup ()) != NULL, "aio_setup");
+  CHECK ((fd = open ("/")) > 1, "open \"/\"");
+
+  ring_queue (ring, AIO_WRITE, fd, buf, sizeof buf, 0, 0);
+  ring_queue (ring, AIO_READ, fd, buf, sizeof buf, 0, 1);
+  CHECK (aio_enter (2, 2) == 2, "submit write and read");
+  for (i = 0; i < 2; i++)
+    {
+      cqe = ring_reap (ring);
+      if (cqe.res != -1)
+        fail ("request %u returned %d", (unsigned) cqe.user_data,
+              (int) cqe.res);
+    }
+  msg ("both failed");
+}
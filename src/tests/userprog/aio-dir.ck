@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(aio-dir) begin
+(aio-dir) aio_setup
+(aio-dir) open "/"
+(aio-dir) submit write and read
+(aio-dir) both failed
+(aio-dir) end
+aio-dir: exit(0)
+EOF
+pass;
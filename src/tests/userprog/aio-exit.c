@@ -0,0 +1,25 @@
+/* Submits reads from an empty pipe, more than the process has
+   workers to run at once, while keeping its writing end open.
+   None can complete, yet the process must still exit cleanly
+   instead of waiting for them forever. */
+
+#include <syscall.h>
+#include "tests/userprog/ring.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[3][16];
+
+void
+test_main (void) 
+{
+  struct aio_ring *ring;
+  int fds[2], i;
+
+  CHECK ((ring = aio_setup ()) != NULL, "aio_setup");
+  CHECK (pipe (fds), "pipe");
+  for (i = 0; i < 3; i++)
+    ring_queue (ring, AIO_READ, fds[0], buf[i], sizeof buf[i], 0, i);
+  CHECK (aio_enter (3, 0) == 3, "submit 3 reads from empty pipe");
+  msg ("exit with reads in flight");
+}
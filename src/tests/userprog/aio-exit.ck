@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(aio-exit) begin
+(aio-exit) aio_setup
+(aio-exit) pipe
+(aio-exit) submit 3 reads from empty pipe
+(aio-exit) exit with reads in flight
+(aio-exit) end
+aio-exit: exit(0)
+EOF
+pass;
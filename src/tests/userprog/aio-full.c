@@ -0,0 +1,46 @@
+/* Fills the completion ring without reaping anything.  Further
+   requests must stay in the submission ring until a completion
+   is reaped. */
+
+#include <syscall.h>
+#include "tests/userprog/ring.h"
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[AIO_RING_ENTRIES + 1];
+
+void
+test_main (void) 
+{
+  struct aio_ring *ring;
+  struct aio_cqe cqe;
+  int fd, i;
+
+  CHECK ((ring = aio_setup ()) != NULL, "aio_setup");
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  /* Read sample.txt a byte per request. */
+  for (i = 0; i < AIO_RING_ENTRIES; i++)
+    ring_queue (ring, AIO_READ, fd, &buf[i], 1, i, i);
+  CHECK (aio_enter (AIO_RING_ENTRIES, AIO_RING_ENTRIES) == AIO_RING_ENTRIES,
+         "submit %d reads", AIO_RING_ENTRIES);
+
+  ring_queue (ring, AIO_READ, fd, &buf[i], 1, i, i);
+  CHECK (aio_enter (1, 0) == 0, "submit with completion ring full");
+  CHECK (ring->sq_head != ring->sq_tail, "request still queued");
+
+  for (i = 0; i < AIO_RING_ENTRIES; i++)
+    {
+      cqe = ring_reap (ring);
+      if (cqe.res != 1)
+        fail ("read %u returned %d", (unsigned) cqe.user_data, (int) cqe.res);
+    }
+  msg ("reaped %d completions", AIO_RING_ENTRIES);
+
+  CHECK (aio_enter (1, 1) == 1, "submit after reaping");
+  cqe = ring_reap (ring);
+  CHECK (cqe.user_data == AIO_RING_ENTRIES && cqe.res == 1,
+         "read completed");
+  compare_bytes (buf, sample, sizeof buf, 0, "sample.txt");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(aio-full) begin
+(aio-full) aio_setup
+(aio-full) open "sample.txt"
+(aio-full) submit 64 reads
+(aio-full) submit with completion ring full
+(aio-full) request still queued
+(aio-full) reaped 64 completions
+(aio-full) submit after reaping
+(aio-full) read completed
+(aio-full) end
+aio-full: exit(0)
+EOF
+pass;
@@ -0,0 +1,52 @@
+/* Writes a file through the asynchronous I/O rings, syncs it,
+   and reads it back, checking each request's completion. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/ring.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char wbuf[512];
+static char rbuf[512];
+
+void
+test_main (void) 
+{
+  struct aio_ring *ring;
+  struct aio_cqe cqe;
+  bool wrote = false, synced = false;
+  int fd, i;
+
+  CHECK ((ring = aio_setup ()) != NULL, "aio_setup");
+  CHECK (create ("data", sizeof wbuf), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  for (i = 0; i < (int) sizeof wbuf; i++)
+    wbuf[i] = i * 7;
+
+  ring_queue (ring, AIO_WRITE, fd, wbuf, sizeof wbuf, 0, 1);
+  ring_queue (ring, AIO_FSYNC, fd, NULL, 0, 0, 2);
+  CHECK (aio_enter (2, 2) == 2, "submit write and fsync");
+
+  /* The two may complete in either order. */
+  for (i = 0; i < 2; i++)
+    {
+      cqe = ring_reap (ring);
+      if (cqe.user_data == 1 && cqe.res == (int) sizeof wbuf)
+        wrote = true;
+      else if (cqe.user_data == 2 && cqe.res == 0)
+        synced = true;
+      else
+        fail ("unexpected completion %u: %d",
+              (unsigned) cqe.user_data, (int) cqe.res);
+    }
+  CHECK (wrote && synced, "write and fsync completed");
+
+  ring_queue (ring, AIO_READ, fd, rbuf, sizeof rbuf, 0, 3);
+  CHECK (aio_enter (1, 1) == 1, "submit read");
+  cqe = ring_reap (ring);
+  CHECK (cqe.user_data == 3 && cqe.res == (int) sizeof rbuf,
+         "read completed");
+  compare_bytes (rbuf, wbuf, sizeof rbuf, 0, "data");
+  msg ("read back what was written");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(aio-rw) begin
+(aio-rw) aio_setup
+(aio-rw) create "data"
+(aio-rw) open "data"
+(aio-rw) submit write and fsync
+(aio-rw) write and fsync completed
+(aio-rw) submit read
+(aio-rw) read completed
+(aio-rw) read back what was written
+(aio-rw) end
+aio-rw: exit(0)
+EOF
+pass;
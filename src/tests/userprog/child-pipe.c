@@ -0,0 +1,24 @@
+/* Child process run by pipe-exec test.
+
+   Writes "child" to the pipe end it inherited as the file
+   descriptor passed as the first command-line argument. */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+int
+main (int argc UNUSED, char *argv[]) 
+{
+  test_name = "child-pipe";
+
+  msg ("begin");
+  if (!isdigit (*argv[1]))
+    fail ("bad command-line arguments");
+  if (write (atoi (argv[1]), "child", 5) != 5)
+    fail ("write to inherited pipe failed");
+  msg ("end");
+
+  return 0;
+}
@@ -0,0 +1,48 @@
+/* Child process run by shm-share and shm-creator tests.
+
+   "child-shm ID" attaches segment ID, checks that it holds
+   "parent", and replaces that with "child".
+
+   "child-shm create ID_FD GO_FD" creates a segment without
+   attaching it, writes its identifier to pipe end ID_FD, and
+   waits for a byte from pipe end GO_FD before exiting. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+int
+main (int argc, char *argv[]) 
+{
+  test_name = "child-shm";
+
+  msg ("begin");
+  if (argc == 4 && !strcmp (argv[1], "create"))
+    {
+      int id = shm_create (4096);
+      char c;
+
+      if (id < 0)
+        fail ("shm_create");
+      if (write (atoi (argv[2]), &id, sizeof id) != sizeof id)
+        fail ("write segment id");
+      if (read (atoi (argv[3]), &c, 1) != 1)
+        fail ("read from parent");
+    }
+  else if (argc == 2)
+    {
+      char *p = shm_attach (atoi (argv[1]));
+
+      if (p == NULL)
+        fail ("shm_attach");
+      if (strcmp (p, "parent"))
+        fail ("segment holds \"%s\", not \"parent\"", p);
+      strlcpy (p, "child", 4096);
+    }
+  else
+    fail ("bad command-line arguments");
+  msg ("end");
+
+  return 0;
+}
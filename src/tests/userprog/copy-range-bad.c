@@ -0,0 +1,43 @@
+/* Passes copy_file_range() the console, a pipe, and overlapping
+   parts of one file, once with a length so large that adding it
+   to an offset would overflow.  Each must return -1 and copy
+   nothing. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+  int a, b;
+
+  CHECK ((a = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((b = open ("sample.txt")) > 1, "open \"sample.txt\" again");
+  CHECK (pipe (fds), "pipe");
+
+  CHECK (copy_file_range (STDIN_FILENO, b, 10) == -1,
+         "copy_file_range from console");
+  CHECK (copy_file_range (a, STDOUT_FILENO, 10) == -1,
+         "copy_file_range to console");
+  CHECK (copy_file_range (fds[0], b, 10) == -1,
+         "copy_file_range from pipe");
+  CHECK (copy_file_range (a, fds[1], 10) == -1,
+         "copy_file_range to pipe");
+
+  msg ("seek second \"sample.txt\" to 10");
+  seek (b, 10);
+  CHECK (copy_file_range (a, b, 20) == -1,
+         "copy_file_range 20 bytes from 0 to 10");
+  CHECK (copy_file_range (a, b, 0x7fffffff) == -1,
+         "copy_file_range 0x7fffffff bytes from 0 to 10");
+  CHECK (tell (a) == 0 && tell (b) == 10, "positions unchanged");
+  msg ("close \"sample.txt\" twice");
+  close (a);
+  close (b);
+
+  check_file ("sample.txt", sample, sizeof sample - 1);
+}
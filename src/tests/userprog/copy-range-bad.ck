@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(copy-range-bad) begin
+(copy-range-bad) open "sample.txt"
+(copy-range-bad) open "sample.txt" again
+(copy-range-bad) pipe
+(copy-range-bad) copy_file_range from console
+(copy-range-bad) copy_file_range to console
+(copy-range-bad) copy_file_range from pipe
+(copy-range-bad) copy_file_range to pipe
+(copy-range-bad) seek second "sample.txt" to 10
+(copy-range-bad) copy_file_range 20 bytes from 0 to 10
+(copy-range-bad) copy_file_range 0x7fffffff bytes from 0 to 10
+(copy-range-bad) positions unchanged
+(copy-range-bad) close "sample.txt" twice
+(copy-range-bad) open "sample.txt" for verification
+(copy-range-bad) verified contents of "sample.txt"
+(copy-range-bad) close "sample.txt"
+(copy-range-bad) end
+copy-range-bad: exit(0)
+EOF
+pass;
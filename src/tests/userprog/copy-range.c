@@ -0,0 +1,29 @@
+/* Copies sample.txt into a new file with copy_file_range(),
+   which must advance both file positions and return 0 once the
+   source is exhausted. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int size = sizeof sample - 1;
+  int in, out;
+
+  CHECK (create ("copy", 0), "create \"copy\"");
+  CHECK ((in = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((out = open ("copy")) > 1, "open \"copy\"");
+  CHECK (copy_file_range (in, out, 1000) == size,
+         "copy_file_range 1000 bytes");
+  CHECK (tell (in) == (unsigned) size && tell (out) == (unsigned) size,
+         "both positions at end of file");
+  CHECK (copy_file_range (in, out, 1000) == 0,
+         "copy_file_range at end of file");
+  msg ("close \"copy\"");
+  close (out);
+
+  check_file ("copy", sample, size);
+}
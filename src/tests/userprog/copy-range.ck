@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(copy-range) begin
+(copy-range) create "copy"
+(copy-range) open "sample.txt"
+(copy-range) open "copy"
+(copy-range) copy_file_range 1000 bytes
+(copy-range) both positions at end of file
+(copy-range) copy_file_range at end of file
+(copy-range) close "copy"
+(copy-range) open "copy" for verification
+(copy-range) verified contents of "copy"
+(copy-range) close "copy"
+(copy-range) end
+copy-range: exit(0)
+EOF
+pass;
@@ -0,0 +1,27 @@
+/* Passes fadvise() an unknown advice value, a negative offset or
+   length, the console, and a pipe end.  Each call must return
+   -1. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+  int fd;
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (fadvise (fd, 0, 0, 99) == -1, "fadvise unknown advice");
+  CHECK (fadvise (fd, -1, 0, POSIX_FADV_WILLNEED) == -1,
+         "fadvise negative offset");
+  CHECK (fadvise (fd, 0, -1, POSIX_FADV_WILLNEED) == -1,
+         "fadvise negative length");
+  CHECK (fadvise (STDIN_FILENO, 0, 0, POSIX_FADV_SEQUENTIAL) == -1,
+         "fadvise console");
+  CHECK (pipe (fds), "pipe");
+  CHECK (fadvise (fds[0], 0, 0, POSIX_FADV_SEQUENTIAL) == -1,
+         "fadvise pipe");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fadvise-bad) begin
+(fadvise-bad) open "sample.txt"
+(fadvise-bad) fadvise unknown advice
+(fadvise-bad) fadvise negative offset
+(fadvise-bad) fadvise negative length
+(fadvise-bad) fadvise console
+(fadvise-bad) pipe
+(fadvise-bad) fadvise pipe
+(fadvise-bad) end
+fadvise-bad: exit(0)
+EOF
+pass;
@@ -0,0 +1,29 @@
+/* Gives each kind of advice for sample.txt with fadvise().  Each
+   call must succeed, and none may change what reads return. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int size = sizeof sample - 1;
+  int fd;
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (fadvise (fd, 0, 0, POSIX_FADV_WILLNEED) == 0, "fadvise WILLNEED");
+  CHECK (fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL) == 0,
+         "fadvise SEQUENTIAL");
+  check_file_handle (fd, "sample.txt", sample, size);
+  CHECK (fadvise (fd, 0, size, POSIX_FADV_DONTNEED) == 0,
+         "fadvise DONTNEED");
+  CHECK (fadvise (fd, 0, 0, POSIX_FADV_RANDOM) == 0, "fadvise RANDOM");
+  seek (fd, 0);
+  check_file_handle (fd, "sample.txt", sample, size);
+  CHECK (fadvise (fd, 0, 0, POSIX_FADV_NOREUSE) == 0, "fadvise NOREUSE");
+  CHECK (fadvise (fd, 0, 0, POSIX_FADV_NORMAL) == 0, "fadvise NORMAL");
+  seek (fd, 0);
+  check_file_handle (fd, "sample.txt", sample, size);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fadvise-normal) begin
+(fadvise-normal) open "sample.txt"
+(fadvise-normal) fadvise WILLNEED
+(fadvise-normal) fadvise SEQUENTIAL
+(fadvise-normal) verified contents of "sample.txt"
+(fadvise-normal) fadvise DONTNEED
+(fadvise-normal) fadvise RANDOM
+(fadvise-normal) verified contents of "sample.txt"
+(fadvise-normal) fadvise NOREUSE
+(fadvise-normal) fadvise NORMAL
+(fadvise-normal) verified contents of "sample.txt"
+(fadvise-normal) end
+fadvise-normal: exit(0)
+EOF
+pass;
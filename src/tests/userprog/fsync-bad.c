@@ -0,0 +1,19 @@
+/* Passes fsync() and fdatasync() the console and pipe ends,
+   which have nothing on disk.  Each call must return -1. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+
+  CHECK (fsync (STDOUT_FILENO) == -1, "fsync console");
+  CHECK (fdatasync (STDIN_FILENO) == -1, "fdatasync console");
+  CHECK (pipe (fds), "pipe");
+  CHECK (fsync (fds[1]) == -1, "fsync pipe");
+  CHECK (fdatasync (fds[0]) == -1, "fdatasync pipe");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fsync-bad) begin
+(fsync-bad) fsync console
+(fsync-bad) fdatasync console
+(fsync-bad) pipe
+(fsync-bad) fsync pipe
+(fsync-bad) fdatasync pipe
+(fsync-bad) end
+fsync-bad: exit(0)
+EOF
+pass;
@@ -0,0 +1,25 @@
+/* Writes a new file, growing it, and syncs it with fsync() and
+   fdatasync(), which must succeed and leave the data intact. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int size = sizeof sample - 1;
+  int fd;
+
+  CHECK (create ("synced", 0), "create \"synced\"");
+  CHECK ((fd = open ("synced")) > 1, "open \"synced\"");
+  CHECK (write (fd, sample, size) == size, "write \"synced\"");
+  CHECK (fsync (fd) == 0, "fsync \"synced\"");
+  CHECK (pwrite (fd, sample, 10, 0) == 10, "overwrite first 10 bytes");
+  CHECK (fdatasync (fd) == 0, "fdatasync \"synced\"");
+  msg ("close \"synced\"");
+  close (fd);
+
+  check_file ("synced", sample, size);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fsync-normal) begin
+(fsync-normal) create "synced"
+(fsync-normal) open "synced"
+(fsync-normal) write "synced"
+(fsync-normal) fsync "synced"
+(fsync-normal) overwrite first 10 bytes
+(fsync-normal) fdatasync "synced"
+(fsync-normal) close "synced"
+(fsync-normal) open "synced" for verification
+(fsync-normal) verified contents of "synced"
+(fsync-normal) close "synced"
+(fsync-normal) end
+fsync-normal: exit(0)
+EOF
+pass;
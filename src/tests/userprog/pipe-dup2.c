@@ -0,0 +1,27 @@
+/* Copies the writing end of a pipe with dup2() and writes
+   through the copy.  End of file must wait until both writing
+   ends are closed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+  char buf[16];
+
+  CHECK (pipe (fds), "pipe");
+  CHECK (dup2 (fds[1], 10) == 10, "dup2 writing end to 10");
+  CHECK (write (10, "hello", 5) == 5, "write \"hello\" to 10");
+  msg ("close original writing end");
+  close (fds[1]);
+  CHECK (read (fds[0], buf, sizeof buf) == 5, "read 5 bytes");
+  if (memcmp (buf, "hello", 5))
+    fail ("read wrong data");
+  msg ("close 10");
+  close (10);
+  CHECK (read (fds[0], buf, sizeof buf) == 0, "read at end of file");
+}
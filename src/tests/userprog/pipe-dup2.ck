@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-dup2) begin
+(pipe-dup2) pipe
+(pipe-dup2) dup2 writing end to 10
+(pipe-dup2) write "hello" to 10
+(pipe-dup2) close original writing end
+(pipe-dup2) read 5 bytes
+(pipe-dup2) close 10
+(pipe-dup2) read at end of file
+(pipe-dup2) end
+pipe-dup2: exit(0)
+EOF
+pass;
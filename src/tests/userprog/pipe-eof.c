@@ -0,0 +1,23 @@
+/* Writes into a pipe and closes its only writing end.  Reading
+   must return the data and then end of file, not block. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+  char buf[16];
+
+  CHECK (pipe (fds), "pipe");
+  CHECK (write (fds[1], "hello", 5) == 5, "write \"hello\"");
+  msg ("close writing end");
+  close (fds[1]);
+  CHECK (read (fds[0], buf, sizeof buf) == 5, "read 5 bytes");
+  if (memcmp (buf, "hello", 5))
+    fail ("read wrong data");
+  CHECK (read (fds[0], buf, sizeof buf) == 0, "read at end of file");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-eof) begin
+(pipe-eof) pipe
+(pipe-eof) write "hello"
+(pipe-eof) close writing end
+(pipe-eof) read 5 bytes
+(pipe-eof) read at end of file
+(pipe-eof) end
+pipe-eof: exit(0)
+EOF
+pass;
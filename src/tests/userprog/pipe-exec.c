@@ -0,0 +1,28 @@
+/* Creates a pipe and runs a child process that writes into it
+   through the descriptor it inherited.  The parent then reads
+   the child's data, and end of file once the child has exited
+   and the parent has closed its own writing end. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char child_cmd[128];
+  int fds[2];
+  char buf[16];
+
+  CHECK (pipe (fds), "pipe");
+  snprintf (child_cmd, sizeof child_cmd, "child-pipe %d", fds[1]);
+  msg ("wait(exec()) = %d", wait (exec (child_cmd)));
+  msg ("close writing end");
+  close (fds[1]);
+  CHECK (read (fds[0], buf, sizeof buf) == 5, "read 5 bytes");
+  if (memcmp (buf, "child", 5))
+    fail ("read wrong data");
+  CHECK (read (fds[0], buf, sizeof buf) == 0, "read at end of file");
+}
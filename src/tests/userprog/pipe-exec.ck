@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-exec) begin
+(pipe-exec) pipe
+(child-pipe) begin
+(child-pipe) end
+child-pipe: exit(0)
+(pipe-exec) wait(exec()) = 0
+(pipe-exec) close writing end
+(pipe-exec) read 5 bytes
+(pipe-exec) read at end of file
+(pipe-exec) end
+pipe-exec: exit(0)
+EOF
+pass;
@@ -0,0 +1,17 @@
+/* Closes the only reading end of a pipe and then writes into
+   it.  The write must fail with -1 rather than block forever. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+
+  CHECK (pipe (fds), "pipe");
+  msg ("close reading end");
+  close (fds[0]);
+  CHECK (write (fds[1], "hello", 5) == -1, "write with no reader");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-no-reader) begin
+(pipe-no-reader) pipe
+(pipe-no-reader) close reading end
+(pipe-no-reader) write with no reader
+(pipe-no-reader) end
+pipe-no-reader: exit(0)
+EOF
+pass;
@@ -0,0 +1,34 @@
+/* Passes pread() and pwrite() a negative offset, and readv()
+   and writev() more than IOV_MAX buffers.  Each must return -1
+   without touching the file. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct iovec iov[IOV_MAX + 1];
+  char buf[IOV_MAX + 1];
+  int fd, i;
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (pread (fd, buf, 1, -1) == -1, "pread at offset -1");
+  CHECK (pwrite (fd, "X", 1, -1) == -1, "pwrite at offset -1");
+
+  for (i = 0; i <= IOV_MAX; i++)
+    {
+      iov[i].iov_base = &buf[i];
+      iov[i].iov_len = 1;
+    }
+  CHECK (readv (fd, iov, IOV_MAX + 1) == -1, "readv %d buffers", IOV_MAX + 1);
+  CHECK (writev (fd, iov, IOV_MAX + 1) == -1,
+         "writev %d buffers", IOV_MAX + 1);
+  CHECK (tell (fd) == 0, "tell \"sample.txt\" is still 0");
+  msg ("close \"sample.txt\"");
+  close (fd);
+
+  check_file ("sample.txt", sample, sizeof sample - 1);
+}
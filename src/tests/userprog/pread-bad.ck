@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-bad) begin
+(pread-bad) open "sample.txt"
+(pread-bad) pread at offset -1
+(pread-bad) pwrite at offset -1
+(pread-bad) readv 17 buffers
+(pread-bad) writev 17 buffers
+(pread-bad) tell "sample.txt" is still 0
+(pread-bad) close "sample.txt"
+(pread-bad) open "sample.txt" for verification
+(pread-bad) verified contents of "sample.txt"
+(pread-bad) close "sample.txt"
+(pread-bad) end
+pread-bad: exit(0)
+EOF
+pass;
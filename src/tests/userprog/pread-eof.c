@@ -0,0 +1,33 @@
+/* Reads across the end of sample.txt with pread() and readv().
+   Each must return only the bytes up to end of file, and 0 once
+   there. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int size = sizeof sample - 1;
+  struct iovec iov[2];
+  char buf[40];
+  int fd;
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (pread (fd, buf, sizeof buf, size - 10) == 10,
+         "pread 40 bytes at 10 before end of file");
+  compare_bytes (buf, sample + size - 10, 10, size - 10, "sample.txt");
+  CHECK (pread (fd, buf, sizeof buf, size) == 0, "pread at end of file");
+
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 20;
+  iov[1].iov_base = buf + 20;
+  iov[1].iov_len = 20;
+  msg ("seek \"sample.txt\" to 30 before end of file");
+  seek (fd, size - 30);
+  CHECK (readv (fd, iov, 2) == 30, "readv 2 buffers of 20 bytes");
+  compare_bytes (buf, sample + size - 30, 30, size - 30, "sample.txt");
+  CHECK (readv (fd, iov, 2) == 0, "readv at end of file");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-eof) begin
+(pread-eof) open "sample.txt"
+(pread-eof) pread 40 bytes at 10 before end of file
+(pread-eof) pread at end of file
+(pread-eof) seek "sample.txt" to 30 before end of file
+(pread-eof) readv 2 buffers of 20 bytes
+(pread-eof) readv at end of file
+(pread-eof) end
+pread-eof: exit(0)
+EOF
+pass;
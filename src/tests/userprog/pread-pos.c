@@ -0,0 +1,32 @@
+/* Reads and writes sample.txt with pread() and pwrite() at
+   offsets away from the file position, which must stay where
+   seek() put it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[32];
+  int fd;
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  msg ("seek \"sample.txt\" to 10");
+  seek (fd, 10);
+
+  CHECK (pread (fd, buf, 20, 50) == 20, "pread 20 bytes at 50");
+  compare_bytes (buf, sample + 50, 20, 50, "sample.txt");
+  CHECK (tell (fd) == 10, "tell \"sample.txt\" is still 10");
+
+  CHECK (pwrite (fd, "XXXXX", 5, 0) == 5, "pwrite 5 bytes at 0");
+  CHECK (tell (fd) == 10, "tell \"sample.txt\" is still 10");
+
+  CHECK (pread (fd, buf, 5, 0) == 5, "pread 5 bytes at 0");
+  compare_bytes (buf, "XXXXX", 5, 0, "sample.txt");
+  CHECK (read (fd, buf, 5) == 5, "read 5 bytes at position");
+  compare_bytes (buf, sample + 10, 5, 10, "sample.txt");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-pos) begin
+(pread-pos) open "sample.txt"
+(pread-pos) seek "sample.txt" to 10
+(pread-pos) pread 20 bytes at 50
+(pread-pos) tell "sample.txt" is still 10
+(pread-pos) pwrite 5 bytes at 0
+(pread-pos) tell "sample.txt" is still 10
+(pread-pos) pread 5 bytes at 0
+(pread-pos) read 5 bytes at position
+(pread-pos) end
+pread-pos: exit(0)
+EOF
+pass;
@@ -0,0 +1,38 @@
+/* Utility functions for tests of the asynchronous I/O rings. */
+
+#include "tests/userprog/ring.h"
+#include "tests/lib.h"
+
+/* Fills in the next free entry of RING's submission ring with a
+   request and makes it visible to the kernel.  The request is
+   not submitted until aio_enter() is called. */
+void
+ring_queue (struct aio_ring *ring, enum aio_opcode opcode, int fd,
+            void *buf, uint32_t len, int32_t offset, uint32_t user_data)
+{
+  struct aio_sqe *sqe = &ring->sq[ring->sq_tail % AIO_RING_ENTRIES];
+
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->buf = buf;
+  sqe->len = len;
+  sqe->offset = offset;
+  sqe->user_data = user_data;
+  asm volatile ("" : : : "memory");
+  ring->sq_tail++;
+}
+
+/* Removes the oldest completion from RING's completion ring and
+   returns it.  Fails if there is none. */
+struct aio_cqe
+ring_reap (struct aio_ring *ring)
+{
+  struct aio_cqe cqe;
+
+  if (ring->cq_head == ring->cq_tail)
+    fail ("completion ring is empty");
+  cqe = ring->cq[ring->cq_head % AIO_RING_ENTRIES];
+  asm volatile ("" : : : "memory");
+  ring->cq_head++;
+  return cqe;
+}
@@ -0,0 +1,11 @@
+#ifndef TESTS_USERPROG_RING_H
+#define TESTS_USERPROG_RING_H
+
+#include <aio-ring.h>
+#include <stdint.h>
+
+void ring_queue (struct aio_ring *, enum aio_opcode, int fd, void *buf,
+                 uint32_t len, int32_t offset, uint32_t user_data);
+struct aio_cqe ring_reap (struct aio_ring *);
+
+#endif /* tests/userprog/ring.h */
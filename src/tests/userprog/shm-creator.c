@@ -0,0 +1,58 @@
+/* Runs child processes that create shared memory segments and
+   exit.  A segment that another process attached before its
+   creator exited must live on; one that nobody attached must be
+   gone with its creator. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Runs a child that creates a segment and returns its
+   identifier.  If ATTACH is true, attaches the segment at *P
+   before letting the child exit.  Waits for the child. */
+static int
+run_creator (bool attach, char **p)
+{
+  char child_cmd[128];
+  int id_fds[2], go_fds[2];
+  pid_t pid;
+  int id;
+
+  if (!pipe (id_fds) || !pipe (go_fds))
+    fail ("pipe");
+  snprintf (child_cmd, sizeof child_cmd, "child-shm create %d %d",
+            id_fds[1], go_fds[0]);
+  if ((pid = exec (child_cmd)) == PID_ERROR)
+    fail ("exec child-shm");
+  if (read (id_fds[0], &id, sizeof id) != sizeof id)
+    fail ("read segment id");
+  if (attach && (*p = shm_attach (id)) == NULL)
+    fail ("shm_attach while creator runs");
+  if (write (go_fds[1], "", 1) != 1)
+    fail ("write to child");
+  msg ("wait(exec()) = %d", wait (pid));
+
+  close (id_fds[0]);
+  close (id_fds[1]);
+  close (go_fds[0]);
+  close (go_fds[1]);
+  return id;
+}
+
+void
+test_main (void) 
+{
+  char *p;
+  int id;
+
+  id = run_creator (true, &p);
+  p[0] = 'x';
+  CHECK (shm_attach (id) != NULL,
+         "shm_attach after creator exited, while attached");
+  CHECK (p[0] == 'x', "segment kept its contents");
+
+  id = run_creator (false, &p);
+  CHECK (shm_attach (id) == NULL,
+         "shm_attach after creator exited, never attached");
+}
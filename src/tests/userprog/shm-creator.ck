@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-creator) begin
+(child-shm) begin
+(child-shm) end
+child-shm: exit(0)
+(shm-creator) wait(exec()) = 0
+(shm-creator) shm_attach after creator exited, while attached
+(shm-creator) segment kept its contents
+(child-shm) begin
+(child-shm) end
+child-shm: exit(0)
+(shm-creator) wait(exec()) = 0
+(shm-creator) shm_attach after creator exited, never attached
+(shm-creator) end
+shm-creator: exit(0)
+EOF
+pass;
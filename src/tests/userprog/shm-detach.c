@@ -0,0 +1,21 @@
+/* Attaches a shared memory segment, detaches it, and then reads
+   where it was attached.  This must terminate the process with
+   a -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  volatile char *p;
+  int id;
+
+  CHECK ((id = shm_create (4096)) >= 0, "shm_create");
+  CHECK ((p = shm_attach (id)) != NULL, "shm_attach");
+  p[0] = 'x';
+  CHECK (shm_detach ((void *) p), "shm_detach");
+  msg ("read after detach: %d", p[0]);
+  fail ("should have exited with -1");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_USER_FAULTS => 1, [<<'EOF']);
+(shm-detach) begin
+(shm-detach) shm_create
+(shm-detach) shm_attach
+(shm-detach) shm_detach
+shm-detach: exit(-1)
+EOF
+pass;
@@ -0,0 +1,29 @@
+/* Creates and attaches a shared memory segment, writes into it,
+   and runs a child process that attaches the same segment,
+   checks what the parent wrote, and writes a reply.  The parent
+   must see the reply. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char child_cmd[128];
+  char *p;
+  int id;
+
+  CHECK ((id = shm_create (4096)) >= 0, "shm_create");
+  CHECK ((p = shm_attach (id)) != NULL, "shm_attach");
+  strlcpy (p, "parent", 4096);
+
+  snprintf (child_cmd, sizeof child_cmd, "child-shm %d", id);
+  msg ("wait(exec()) = %d", wait (exec (child_cmd)));
+  if (strcmp (p, "child"))
+    fail ("segment holds \"%s\", not the child's reply", p);
+  msg ("read child's reply");
+  CHECK (shm_detach (p), "shm_detach");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-share) begin
+(shm-share) shm_create
+(shm-share) shm_attach
+(child-shm) begin
+(child-shm) end
+child-shm: exit(0)
+(shm-share) wait(exec()) = 0
+(shm-share) read child's reply
+(shm-share) shm_detach
+(shm-share) end
+shm-share: exit(0)
+EOF
+pass;
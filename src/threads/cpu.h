@@ -0,0 +1,107 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/flags.h"
+
+/* Feature bits returned in EDX by CPUID leaf 1.
+   See [IA32-v2a] "CPUID". */
+#define CPUID_PSE (1u << 3)     /* 4 MB pages. */
+#define CPUID_TSC (1u << 4)     /* Time stamp counter. */
+#define CPUID_SEP (1u << 11)    /* SYSENTER and SYSEXIT. */
+#define CPUID_PGE (1u << 13)    /* Global pages. */
+
+/* CR4 bits.  See [IA32-v3a] 2.5 "Control Registers". */
+#define CR4_PSE 0x00000010      /* Page size extensions. */
+#define CR4_PGE 0x00000080      /* Page global enable. */
+
+/* Executes CPUID with EAX set to LEAF, storing the resulting
+   registers into *A, *B, *C, and *D. */
+static inline void
+cpuid (uint32_t leaf, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d)
+{
+  asm volatile ("cpuid"
+                : "=a" (*a), "=b" (*b), "=c" (*c), "=d" (*d)
+                : "a" (leaf));
+}
+
+/* Returns the feature bits (CPUID_*) that the CPU reports, or 0
+   if the CPU is too old to have the CPUID instruction, which we
+   detect by whether the ID flag in EFLAGS can be toggled. */
+static inline uint32_t
+cpu_features (void)
+{
+  uint32_t before, after, a, b, c, d;
+
+  asm volatile ("pushfl; popl %0; movl %0, %1; xorl %2, %1; "
+                "pushl %1; popfl; pushfl; popl %1; pushl %0; popfl"
+                : "=&r" (before), "=&r" (after)
+                : "i" (FLAG_ID));
+  if (((before ^ after) & FLAG_ID) == 0)
+    return 0;
+
+  cpuid (0, &a, &b, &c, &d);
+  if (a < 1)
+    return 0;
+  cpuid (1, &a, &b, &c, &d);
+  return d;
+}
+
+/* Returns the contents of CR4. */
+static inline uint32_t
+cr4_read (void)
+{
+  uint32_t cr4;
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  return cr4;
+}
+
+/* Sets CR4 to CR4. */
+static inline void
+cr4_write (uint32_t cr4)
+{
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4) : "memory");
+}
+
+/* Model-specific registers.  See [IA32-v3a] 4.8.7
+   "Sysenter/Sysexit Instructions". */
+#define MSR_SYSENTER_CS  0x174  /* Code segment for SYSENTER. */
+#define MSR_SYSENTER_ESP 0x175  /* Stack pointer for SYSENTER. */
+#define MSR_SYSENTER_EIP 0x176  /* Entry point for SYSENTER. */
+
+/* Returns model-specific register MSR. */
+static inline uint64_t
+rdmsr (uint32_t msr)
+{
+  uint64_t value;
+  asm volatile ("rdmsr" : "=A" (value) : "c" (msr));
+  return value;
+}
+
+/* Sets model-specific register MSR to VALUE. */
+static inline void
+wrmsr (uint32_t msr, uint64_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "A" (value));
+}
+
+/* Returns the time stamp counter, which counts CPU cycles.
+   See [IA32-v2b] "RDTSC". */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Invalidates the TLB entry for virtual address VADDR, even if it
+   is global.  See [IA32-v2a] "INVLPG". */
+static inline void
+invlpg (const void *vaddr)
+{
+  asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+}
+
+#endif /* threads/cpu.h */
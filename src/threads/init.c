@@ -15,6 +15,7 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
@@ -22,6 +23,7 @@
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/vmalloc.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -34,6 +36,10 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/iosched.h"
+#include "devices/ramdisk.h"
+#include "devices/stripe.h"
+#include "devices/virtio.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #include "filesys/cache.h"
@@ -53,11 +59,25 @@ static const char *scratch_bdev_name;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
+
+/* -ramdisk: Size of the RAM disk in kB, 0 for none.
+   -ramdisk-load: Name of the block device to preload it from. */
+static size_t ramdisk_kb;
+static const char *ramdisk_load_name;
+
+/* -stripe: Comma-separated names of the block devices to stripe
+   into the file system device.
+   -stripe-chunk: Sectors per stripe chunk. */
+static const char *stripe_names;
+static block_sector_t stripe_chunk = 16;
 #endif /* FILESYS */
 
-/* -ul: Maximum number of pages to put into palloc's user pool. */
+/* -ul: Maximum number of user pages palloc may hand out. */
 static size_t user_page_limit = SIZE_MAX;
 
+/* -mtrack: Account malloc() allocations to their call sites? */
+static bool malloc_track;
+
 static void bss_init (void);
 static void paging_init (void);
 
@@ -97,8 +117,9 @@ main (void)
 
   /* Initialize memory system. */
   palloc_init (user_page_limit);
-  malloc_init ();
+  malloc_init (malloc_track);
   paging_init ();
+  vmalloc_init ();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -125,6 +146,14 @@ main (void)
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init ();
+  virtio_init ();
+  ramdisk_init (ramdisk_kb, ramdisk_load_name);
+  if (stripe_names != NULL)
+    {
+      struct block *stripe = stripe_init (stripe_names, stripe_chunk);
+      if (filesys_bdev_name == NULL)
+        filesys_bdev_name = block_name (stripe);
+    }
   locate_block_devices ();
   filesys_init (format_filesys);
   filesys_cache_enable ();
@@ -156,13 +185,25 @@ bss_init (void)
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports it, each 4 MB of RAM is mapped with a
+   single large page instead of a page table, except for the
+   first 4 MB, which holds the read-only kernel text, and any
+   partial 4 MB at the end of RAM.  If the CPU also supports
+   global pages, all of these kernel mappings are marked global,
+   so that switching page directories with pagedir_activate()
+   does not flush them from the TLB. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  uint32_t features = cpu_features ();
+  bool pse = (features & CPUID_PSE) != 0;
+  uint32_t global = features & CPUID_PGE ? PTE_G : 0;
+  size_t large_pages = PTSPAN / PGSIZE;
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -174,21 +215,39 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (pse && pte_idx == 0 && page + large_pages <= init_ram_pages
+          && !(vaddr < &_end_kernel_text && &_start < vaddr + PTSPAN))
+        {
+          pd[pde_idx] = pde_create_large (vaddr, true) | global;
+          page += large_pages - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | global;
     }
 
+  /* Large pages must be enabled before the page directory that
+     uses them is loaded.  See [IA32-v3a] 3.6.1 "Paging Options". */
+  if (pse)
+    cr4_write (cr4_read () | CR4_PSE);
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
+
+  /* Only now honor the global bit, so that no stale global
+     entry from the loader's page tables survives. */
+  if (global)
+    cr4_write (cr4_read () | CR4_PGE);
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -250,6 +309,21 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-pio"))
+        ide_pio_only = true;
+      else if (!strcmp (name, "-iosched"))
+        {
+          if (!iosched_set_default (value))
+            PANIC ("unknown I/O scheduler `%s'", value != NULL ? value : "");
+        }
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_kb = atoi (value);
+      else if (!strcmp (name, "-ramdisk-load"))
+        ramdisk_load_name = value;
+      else if (!strcmp (name, "-stripe"))
+        stripe_names = value;
+      else if (!strcmp (name, "-stripe-chunk"))
+        stripe_chunk = atoi (value);
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -259,6 +333,8 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-mtrack"))
+        malloc_track = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -295,6 +371,24 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+/* Prints memory allocator statistics. */
+static void
+print_memstat (char **argv UNUSED)
+{
+  palloc_print_stats ();
+  malloc_print_stats ();
+  vmalloc_print_stats ();
+}
+
+#ifdef FILESYS
+/* Prints block device statistics. */
+static void
+print_iostat (char **argv UNUSED)
+{
+  block_print_stats ();
+}
+#endif
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -312,7 +406,9 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+      {"memstat", 1, print_memstat},
 #ifdef FILESYS
+      {"iostat", 1, print_iostat},
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
       {"rm", 2, fsutil_rm},
@@ -360,7 +456,9 @@ usage (void)
 #else
           "  run TEST           Run TEST.\n"
 #endif
+          "  memstat            Print page and heap allocator statistics.\n"
 #ifdef FILESYS
+          "  iostat             Print block device I/O statistics.\n"
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
           "  rm FILE            Delete FILE.\n"
@@ -376,12 +474,22 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -pio               Use PIO instead of DMA for IDE disks.\n"
+          "  -iosched=NAME      Schedule disk requests with NAME: deadline\n"
+          "                     (default), clook, noop, or none.\n"
+          "  -ramdisk=KB        Create a KB kB RAM disk, ram0.  Use it\n"
+          "                     with -filesys=ram0 or -swap=ram0.\n"
+          "  -ramdisk-load=BDEV Fill the RAM disk from BDEV at startup.\n"
+          "  -stripe=BDEV,...   Stripe BDEVs into md0, the default file\n"
+          "                     system device.\n"
+          "  -stripe-chunk=N    Stripe N sectors at a time (default 16).\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -mtrack            Account heap allocations to call sites.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -415,6 +523,8 @@ locate_block_device (enum block_type role, const char *name)
       block = block_get_by_name (name);
       if (block == NULL)
         PANIC ("No such block device \"%s\"", name);
+      if (stripe_is_member (block))
+        PANIC ("Block device \"%s\" is part of a stripe", name);
     }
   else
     {
@@ -8,6 +8,7 @@
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 
 /* A simple implementation of malloc().
 
@@ -32,7 +33,16 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.  If the
+   page allocator can't find enough contiguous pages, we map
+   scattered ones with vmalloc() instead.
+
+   For accounting, each descriptor counts its arenas and in-use
+   blocks, so that we can report how well each size class uses
+   its pages.  If site tracking is enabled by malloc_init(), each
+   block is also prefixed by a small tag that records the
+   allocation's call site and requested size, and live bytes and
+   block counts are kept per call site. */
 
 /* Descriptor. */
 struct desc
@@ -41,6 +51,9 @@ struct desc
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+
+    size_t arena_cnt;           /* Number of arenas allocated. */
+    size_t used_cnt;            /* Number of blocks in use. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -64,15 +77,55 @@ struct block
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Big block statistics, protected by big_lock. */
+static struct lock big_lock;
+static size_t big_cnt;          /* Number of big blocks in use. */
+static size_t big_pages;        /* Pages used by big blocks. */
+
+/* Call site of an allocation. */
+struct malloc_site
+  {
+    const void *caller;         /* Return address into the caller. */
+    size_t live_bytes;          /* Requested bytes still allocated. */
+    size_t live_cnt;            /* Blocks still allocated. */
+    size_t total_cnt;           /* Allocations ever made. */
+  };
+
+/* Tag prepended to each block when site tracking is enabled. */
+struct site_tag
+  {
+    struct malloc_site *site;   /* Allocating call site. */
+    size_t size;                /* Requested size in bytes. */
+  };
+
+/* Call site table, an open-addressed hash table keyed by
+   caller.  Once it fills up, further call sites are lumped
+   together in the last entry, whose caller is null. */
+#define SITE_CNT 128
+static struct malloc_site sites[SITE_CNT + 1];
+static struct lock site_lock;
+
+/* Whether blocks are tagged with their call site.  Fixed at
+   malloc_init() so that every block has a tag, or none does. */
+static bool track_sites;
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void *do_malloc (size_t size, const void *caller);
+static void do_free (void *p);
 
-/* Initializes the malloc() descriptors. */
+/* Initializes the malloc() descriptors.
+   If TRACK is true, allocations are accounted to their call
+   sites, at the cost of a few bytes per block. */
 void
-malloc_init (void) 
+malloc_init (bool track) 
 {
   size_t block_size;
 
+  track_sites = track;
+  lock_init (&big_lock);
+  lock_init (&site_lock);
+
   for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
     {
       struct desc *d = &descs[desc_cnt++];
@@ -84,10 +137,11 @@ malloc_init (void)
     }
 }
 
-/* Obtains and returns a new block of at least SIZE bytes.
+/* Obtains and returns a new block of at least SIZE bytes,
+   without any site tag.
    Returns a null pointer if memory is not available. */
-void *
-malloc (size_t size) 
+static void *
+raw_malloc (size_t size) 
 {
   struct desc *d;
   struct block *b;
@@ -105,9 +159,13 @@ malloc (size_t size)
   if (d == descs + desc_cnt) 
     {
       /* SIZE is too big for any descriptor.
-         Allocate enough pages to hold SIZE plus an arena. */
+         Allocate enough pages to hold SIZE plus an arena.
+         If that many physically contiguous pages aren't free,
+         settle for virtually contiguous ones. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
       a = palloc_get_multiple (0, page_cnt);
+      if (a == NULL && page_cnt > 1)
+        a = vmalloc (page_cnt * PGSIZE);
       if (a == NULL)
         return NULL;
 
@@ -116,6 +174,11 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
+
+      lock_acquire (&big_lock);
+      big_cnt++;
+      big_pages += page_cnt;
+      lock_release (&big_lock);
       return a + 1;
     }
 
@@ -143,16 +206,78 @@ malloc (size_t size)
           struct block *b = arena_to_block (a, i);
           list_push_back (&d->free_list, &b->free_elem);
         }
+      d->arena_cnt++;
     }
 
   /* Get a block from free list and return it. */
   b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
   a = block_to_arena (b);
   a->free_cnt--;
+  d->used_cnt++;
   lock_release (&d->lock);
   return b;
 }
 
+/* Returns the call site entry for CALLER, creating it if
+   necessary.  Must be called with site_lock held. */
+static struct malloc_site *
+find_site (const void *caller)
+{
+  size_t i = ((uintptr_t) caller >> 2) % SITE_CNT;
+  size_t probes;
+
+  for (probes = 0; probes < SITE_CNT; probes++)
+    {
+      struct malloc_site *s = &sites[i];
+      if (s->caller == caller)
+        return s;
+      if (s->caller == NULL)
+        {
+          s->caller = caller;
+          return s;
+        }
+      i = (i + 1) % SITE_CNT;
+    }
+  return &sites[SITE_CNT];
+}
+
+/* Obtains a block of at least SIZE bytes on behalf of CALLER.
+   Returns a null pointer if memory is not available. */
+static void *
+do_malloc (size_t size, const void *caller)
+{
+  struct site_tag *tag;
+
+  /* A null pointer satisfies a request for 0 bytes. */
+  if (size == 0)
+    return NULL;
+  if (!track_sites)
+    return raw_malloc (size);
+
+  if (size + sizeof *tag < size)
+    return NULL;
+  tag = raw_malloc (size + sizeof *tag);
+  if (tag == NULL)
+    return NULL;
+
+  lock_acquire (&site_lock);
+  tag->site = find_site (caller);
+  tag->size = size;
+  tag->site->live_bytes += size;
+  tag->site->live_cnt++;
+  tag->site->total_cnt++;
+  lock_release (&site_lock);
+  return tag + 1;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size) 
+{
+  return do_malloc (size, __builtin_return_address (0));
+}
+
 /* Allocates and return A times B bytes initialized to zeroes.
    Returns a null pointer if memory is not available. */
 void *
@@ -167,7 +292,7 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = do_malloc (size, __builtin_return_address (0));
   if (p != NULL)
     memset (p, 0, size);
 
@@ -179,10 +304,17 @@ static size_t
 block_size (void *block) 
 {
   struct block *b = block;
-  struct arena *a = block_to_arena (b);
-  struct desc *d = a->desc;
+  struct arena *a;
+  struct desc *d;
+
+  if (track_sites)
+    b = (struct block *) ((struct site_tag *) block - 1);
+  a = block_to_arena (b);
+  d = a->desc;
 
-  return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
+  if (d != NULL)
+    return d->block_size - ((uint8_t *) block - (uint8_t *) b);
+  return PGSIZE * a->free_cnt - pg_ofs (block);
 }
 
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
@@ -201,7 +333,7 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block = do_malloc (new_size, __builtin_return_address (0));
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
@@ -217,6 +349,23 @@ realloc (void *old_block, size_t new_size)
    malloc(), calloc(), or realloc(). */
 void
 free (void *p) 
+{
+  if (p != NULL && track_sites)
+    {
+      struct site_tag *tag = (struct site_tag *) p - 1;
+
+      lock_acquire (&site_lock);
+      tag->site->live_bytes -= tag->size;
+      tag->site->live_cnt--;
+      lock_release (&site_lock);
+      p = tag;
+    }
+  do_free (p);
+}
+
+/* Frees block P, which has no site tag. */
+static void
+do_free (void *p) 
 {
   if (p != NULL)
     {
@@ -237,6 +386,7 @@ free (void *p)
 
           /* Add block to free list. */
           list_push_front (&d->free_list, &b->free_elem);
+          d->used_cnt--;
 
           /* If the arena is now entirely unused, free it. */
           if (++a->free_cnt >= d->blocks_per_arena) 
@@ -250,6 +400,7 @@ free (void *p)
                   list_remove (&b->free_elem);
                 }
               palloc_free_page (a);
+              d->arena_cnt--;
             }
 
           lock_release (&d->lock);
@@ -257,12 +408,78 @@ free (void *p)
       else
         {
           /* It's a big block.  Free its pages. */
-          palloc_free_multiple (a, a->free_cnt);
+          lock_acquire (&big_lock);
+          big_cnt--;
+          big_pages -= a->free_cnt;
+          lock_release (&big_lock);
+          if (is_vmalloc_addr (a))
+            vfree (a);
+          else
+            palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
 }
 
+/* Prints per-size-class arena utilization and, if site
+   tracking is enabled, the call sites holding the most live
+   memory. */
+void
+malloc_print_stats (void) 
+{
+  struct desc *d;
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    {
+      size_t slots, pct;
+
+      lock_acquire (&d->lock);
+      slots = d->arena_cnt * d->blocks_per_arena;
+      pct = slots > 0 ? d->used_cnt * 100 / slots : 0;
+      if (d->arena_cnt > 0)
+        printf ("Malloc: %4zu-byte blocks: %zu arenas, %zu of %zu blocks "
+                "in use (%zu%%)\n",
+                d->block_size, d->arena_cnt, d->used_cnt, slots, pct);
+      lock_release (&d->lock);
+    }
+
+  lock_acquire (&big_lock);
+  printf ("Malloc: %zu big blocks in %zu pages\n", big_cnt, big_pages);
+  lock_release (&big_lock);
+
+  if (track_sites)
+    {
+      /* Print the sites with the most live bytes, largest
+         first, by repeatedly selecting the largest entry not
+         yet printed. */
+      bool printed[SITE_CNT + 1];
+      size_t n;
+
+      memset (printed, 0, sizeof printed);
+      lock_acquire (&site_lock);
+      for (n = 0; n < 16; n++)
+        {
+          size_t best = SITE_CNT + 1;
+          size_t i;
+
+          for (i = 0; i <= SITE_CNT; i++)
+            if (!printed[i] && sites[i].live_cnt > 0
+                && (best > SITE_CNT
+                    || sites[i].live_bytes > sites[best].live_bytes))
+              best = i;
+          if (best > SITE_CNT)
+            break;
+
+          printed[best] = true;
+          printf ("Malloc: site %p: %zu bytes in %zu blocks live, "
+                  "%zu allocations\n",
+                  sites[best].caller, sites[best].live_bytes,
+                  sites[best].live_cnt, sites[best].total_cnt);
+        }
+      lock_release (&site_lock);
+    }
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
@@ -1,6 +1,7 @@
 #include "threads/palloc.h"
 #include "kernel/debug.h"
 #include "threads/loader.h"
+#include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include <bitmap.h>
@@ -16,29 +17,61 @@
    page-multiple) chunks.  See malloc.h for an allocator that
    hands out smaller chunks.
 
-   System memory is divided into two "pools" called the kernel
-   and user pools.  The user pool is for user (virtual) memory
-   pages, the kernel pool for everything else.  The idea here is
-   that the kernel needs to have memory for its own operations
-   even if user processes are swapping like mad.
+   All free memory forms a single pool that serves two classes
+   of pages: user pages, for user (virtual) memory, and kernel
+   pages, for everything else.  Neither class owns a fixed part
+   of memory.  Instead, each class has a reserve, a number of
+   pages that the other class may never eat into, and a limit,
+   the most pages it may hold at once.  The idea is that the
+   kernel needs to have memory for its own operations even if
+   user processes are swapping like mad, without leaving half of
+   RAM idle when the kernel needs more for, say, its buffer cache
+   and threads.
 
-   By default, half of system RAM is given to the kernel pool and
-   half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   By default, a quarter of memory is reserved for each class,
+   and either class may borrow the rest.  The -ul option limits
+   the user class; its reserve shrinks to fit under the limit.
 
-/* A memory pool. */
+   Kernel pages are allocated from the bottom of the pool and
+   user pages from the top, so that the two classes do not
+   fragment each other's contiguous runs. */
+
+/* Use classes. */
+enum page_class
+{
+  CLASS_KERNEL,            /* Kernel pages. */
+  CLASS_USER,              /* User pages. */
+  CLASS_CNT                /* Number of classes. */
+};
+
+/* Accounting for one use class. */
+struct page_class_info
+{
+  const char *name;        /* Name, for statistics. */
+  size_t used;             /* Pages currently allocated. */
+  size_t peak;             /* Maximum of USED over time. */
+  size_t reserve;          /* Pages guaranteed to this class. */
+  size_t limit;            /* Maximum pages in this class. */
+  size_t failures;         /* Allocations refused. */
+};
+
+/* The memory pool. */
 struct pool
 {
-  struct lock lock;        /* Mutual exclusion. */
+  struct lock lock;        /* Mutual exclusion between allocators. */
   struct bitmap *used_map; /* Bitmap of free pages. */
+  struct bitmap *user_map; /* Bitmap of pages owned by CLASS_USER. */
   uint8_t *base;           /* Base of pool. */
+  size_t page_cnt;         /* Number of pages in pool. */
+  struct page_class_info classes[CLASS_CNT];
 };
 
-/* Two pools: one for kernel data, one for user pages. */
-static struct pool kernel_pool, user_pool;
+/* The single page pool. */
+static struct pool pool;
 
-static void init_pool (struct pool *, void *base, size_t page_cnt,
-                       const char *name);
+static bool reserve_allows (const struct pool *, enum page_class,
+                            size_t page_cnt);
+static size_t scan_down_and_flip (struct bitmap *, size_t page_cnt);
 static bool page_from_pool (const struct pool *, void *page);
 
 /* Convert palloc_flags to string. */
@@ -64,7 +97,7 @@ palloc_flags_to_str (enum palloc_flags flags)
 }
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
-   pages are put into the user pool. */
+   pages may be allocated as user pages at any one time. */
 void
 palloc_init (size_t user_page_limit)
 {
@@ -72,40 +105,84 @@ palloc_init (size_t user_page_limit)
   uint8_t *free_start = ptov (1024 * 1024);
   uint8_t *free_end = ptov (init_ram_pages * PGSIZE);
   size_t free_pages = (free_end - free_start) / PGSIZE;
-  size_t user_pages = free_pages / 2;
-  size_t kernel_pages;
-  if (user_pages > user_page_limit)
-    user_pages = user_page_limit;
-  kernel_pages = free_pages - user_pages;
-
-  /* Give half of memory to kernel, half to user. */
-  init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
-  init_pool (&user_pool, free_start + kernel_pages * PGSIZE, user_pages,
-             "user pool");
+  size_t bm_size = bitmap_buf_size (free_pages);
+  size_t bm_pages = DIV_ROUND_UP (2 * bm_size, PGSIZE);
+  struct page_class_info *kernel = &pool.classes[CLASS_KERNEL];
+  struct page_class_info *user = &pool.classes[CLASS_USER];
+
+  /* We'll put the pool's bitmaps at its base.
+     Calculate the space needed for them
+     and subtract it from the pool's size. */
+  if (bm_pages > free_pages)
+    PANIC ("Not enough memory for page pool bitmaps.");
+  free_pages -= bm_pages;
+
+  lock_init (&pool.lock);
+  pool.used_map = bitmap_create_in_buf (free_pages, free_start, bm_size);
+  pool.user_map = bitmap_create_in_buf (free_pages, free_start + bm_size,
+                                        bm_size);
+  pool.base = free_start + bm_pages * PGSIZE;
+  pool.page_cnt = free_pages;
+
+  kernel->name = "kernel";
+  kernel->reserve = free_pages / 4;
+  kernel->limit = free_pages;
+
+  user->name = "user";
+  user->limit = user_page_limit < free_pages ? user_page_limit : free_pages;
+  user->reserve = free_pages / 4 < user->limit ? free_pages / 4 : user->limit;
+
+  printf ("%zu pages available, %zu reserved for kernel, "
+          "%zu for user (limit %zu).\n",
+          free_pages, kernel->reserve, user->reserve, user->limit);
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
-   If PAL_USER is set, the pages are obtained from the user pool,
-   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
-   then the pages are filled with zeros.  If too few pages are
-   available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   If PAL_USER is set, the pages are user pages, otherwise kernel
+   pages.  If PAL_ZERO is set in FLAGS, then the pages are filled
+   with zeros.  If too few pages are available, or handing them
+   out would exceed the class's limit or break into the other
+   class's reserve, returns a null pointer, unless PAL_ASSERT is
+   set in FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
-  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum page_class class = flags & PAL_USER ? CLASS_USER : CLASS_KERNEL;
+  struct page_class_info *c = &pool.classes[class];
+  enum intr_level old_level;
   void *pages;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  /* The lock orders allocators.  Interrupts are also disabled,
+     because palloc_free_multiple() updates the same counters
+     without the lock. */
+  lock_acquire (&pool.lock);
+  old_level = intr_disable ();
+  if (!reserve_allows (&pool, class, page_cnt))
+    page_idx = BITMAP_ERROR;
+  else if (class == CLASS_USER)
+    page_idx = scan_down_and_flip (pool.used_map, page_cnt);
+  else
+    page_idx = bitmap_scan_and_flip (pool.used_map, 0, page_cnt, false);
+
+  if (page_idx != BITMAP_ERROR)
+    {
+      bitmap_set_multiple (pool.user_map, page_idx, page_cnt,
+                           class == CLASS_USER);
+      c->used += page_cnt;
+      if (c->used > c->peak)
+        c->peak = c->used;
+    }
+  else
+    c->failures++;
+  intr_set_level (old_level);
+  lock_release (&pool.lock);
 
   if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
+    pages = pool.base + PGSIZE * page_idx;
   else
     pages = NULL;
 
@@ -117,18 +194,18 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   else
     {
       if (flags & PAL_ASSERT)
-        PANIC ("palloc_get: out of pages");
+        PANIC ("palloc_get: out of %s pages", c->name);
     }
   return pages;
 }
 
 /* Obtains a single free page and returns its kernel virtual
    address.
-   If PAL_USER is set, the page is obtained from the user pool,
-   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
-   then the page is filled with zeros.  If no pages are
-   available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   If PAL_USER is set, the page is a user page, otherwise a
+   kernel page.  If PAL_ZERO is set in FLAGS, then the page is
+   filled with zeros.  If no pages are available, returns a null
+   pointer, unless PAL_ASSERT is set in FLAGS, in which case the
+   kernel panics. */
 void *
 palloc_get_page (enum palloc_flags flags)
 {
@@ -139,28 +216,32 @@ palloc_get_page (enum palloc_flags flags)
 void
 palloc_free_multiple (void *pages, size_t page_cnt)
 {
-  struct pool *pool;
+  enum intr_level old_level;
+  enum page_class class;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
     return;
 
-  if (page_from_pool (&kernel_pool, pages))
-    pool = &kernel_pool;
-  else if (page_from_pool (&user_pool, pages))
-    pool = &user_pool;
-  else
-    NOT_REACHED ();
-
-  page_idx = pg_no (pages) - pg_no (pool->base);
+  ASSERT (page_from_pool (&pool, pages));
+  page_idx = pg_no (pages) - pg_no (pool.base);
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  /* Pages may be freed while switching threads, where sleeping
+     on the lock is not an option, so only disable interrupts. */
+  old_level = intr_disable ();
+  ASSERT (bitmap_all (pool.used_map, page_idx, page_cnt));
+  class = bitmap_test (pool.user_map, page_idx) ? CLASS_USER : CLASS_KERNEL;
+  ASSERT (class == CLASS_USER
+          ? bitmap_all (pool.user_map, page_idx, page_cnt)
+          : bitmap_none (pool.user_map, page_idx, page_cnt));
+  bitmap_set_multiple (pool.used_map, page_idx, page_cnt, false);
+  pool.classes[class].used -= page_cnt;
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -170,35 +251,94 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
-/* Initializes pool P as starting at START and ending at END,
-   naming it NAME for debugging purposes. */
-static void
-init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
+/* Prints pool usage and fragmentation statistics: how many
+   pages are free, in how many separate runs, and the longest
+   run, which bounds the largest palloc_get_multiple() that can
+   succeed.  Then prints usage for each class. */
+void
+palloc_print_stats (void)
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  size_t free_cnt = 0, run_cnt = 0, max_run = 0, run = 0;
+  size_t i;
+
+  lock_acquire (&pool.lock);
+  for (i = 0; i < pool.page_cnt; i++)
+    if (!bitmap_test (pool.used_map, i))
+      {
+        free_cnt++;
+        if (run++ == 0)
+          run_cnt++;
+        if (run > max_run)
+          max_run = run;
+      }
+    else
+      run = 0;
+  lock_release (&pool.lock);
+
+  printf ("Palloc: %zu of %zu pages used, %zu free in %zu runs, "
+          "largest run %zu pages\n",
+          pool.page_cnt - free_cnt, pool.page_cnt, free_cnt, run_cnt,
+          max_run);
+  for (i = 0; i < CLASS_CNT; i++)
+    {
+      const struct page_class_info *c = &pool.classes[i];
+      printf ("Palloc: %s: %zu pages used (peak %zu), reserve %zu, "
+              "limit %zu, %zu failed requests\n",
+              c->name, c->used, c->peak, c->reserve, c->limit, c->failures);
+    }
+}
 
-  printf ("%zu pages available in %s.\n", page_cnt, name);
+/* Returns true if CLASS may take PAGE_CNT more pages from POOL
+   without exceeding its limit or leaving too few free pages to
+   honor the other classes' remaining reserves. */
+static bool
+reserve_allows (const struct pool *p, enum page_class class, size_t page_cnt)
+{
+  const struct page_class_info *c = &p->classes[class];
+  size_t used = 0, held = 0;
+  int i;
+
+  if (page_cnt > c->limit - c->used)
+    return false;
+
+  for (i = 0; i < CLASS_CNT; i++)
+    {
+      const struct page_class_info *other = &p->classes[i];
+      used += other->used;
+      if (i != (int) class && other->used < other->reserve)
+        held += other->reserve - other->used;
+    }
+  return page_cnt + held <= p->page_cnt - used;
+}
+
+/* Finds the highest-numbered group of PAGE_CNT consecutive free
+   pages in B, marks them used, and returns the index of the
+   first one, or BITMAP_ERROR if there is no such group. */
+static size_t
+scan_down_and_flip (struct bitmap *b, size_t page_cnt)
+{
+  size_t run = 0;
+  size_t i;
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  for (i = bitmap_size (b); i-- > 0; )
+    if (bitmap_test (b, i))
+      run = 0;
+    else if (++run == page_cnt)
+      {
+        bitmap_set_multiple (b, i, page_cnt, true);
+        return i;
+      }
+  return BITMAP_ERROR;
 }
 
 /* Returns true if PAGE was allocated from POOL,
    false otherwise. */
 static bool
-page_from_pool (const struct pool *pool, void *page)
+page_from_pool (const struct pool *p, void *page)
 {
   size_t page_no = pg_no (page);
-  size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t start_page = pg_no (p->base);
+  size_t end_page = start_page + p->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
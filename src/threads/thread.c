@@ -29,6 +29,11 @@ static struct list ready_list;
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
+/* Hash table of all threads, keyed by tid, for thread_find().
+   Like all_list, accessed only with interrupts off. */
+#define TID_BUCKETS 64
+static struct list tid_buckets[TID_BUCKETS];
+
 /* Idle thread. */
 static struct thread *idle_thread;
 
@@ -71,6 +76,7 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void tid_table_insert (struct thread *);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -88,17 +94,22 @@ static tid_t allocate_tid (void);
 void
 thread_init (void)
 {
+  size_t i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
   list_init (&ready_list);
   list_init (&all_list);
+  for (i = 0; i < TID_BUCKETS; i++)
+    list_init (&tid_buckets[i]);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid ();
+  tid_table_insert (initial_thread);
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -183,6 +194,7 @@ thread_create (const char *name, int priority, thread_func *function,
   /* Initialize thread. */
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
+  tid_table_insert (t);
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -203,7 +215,14 @@ thread_create (const char *name, int priority, thread_func *function,
   /* Create process. */
   pid_t p = process_create (t);
   if (p == TID_ERROR)
-    return TID_ERROR;
+    {
+      enum intr_level old_level = intr_disable ();
+      list_remove (&t->allelem);
+      list_remove (&t->tidelem);
+      intr_set_level (old_level);
+      palloc_free_page (t);
+      return TID_ERROR;
+    }
 #endif
 
   /* Add to run queue. */
@@ -288,16 +307,36 @@ thread_tid (void)
 struct thread *
 thread_find (tid_t tid)
 {
+  struct list *bucket = &tid_buckets[(unsigned) tid % TID_BUCKETS];
+  struct thread *found = NULL;
+  enum intr_level old_level;
   struct list_elem *e;
 
-  for (e = list_begin (&all_list); e != list_end (&all_list);
-       e = list_next (e))
+  old_level = intr_disable ();
+  for (e = list_begin (bucket); e != list_end (bucket); e = list_next (e))
     {
-      struct thread *t = list_entry (e, struct thread, allelem);
+      struct thread *t = list_entry (e, struct thread, tidelem);
       if (t->tid == tid)
-        return t;
+        {
+          found = t;
+          break;
+        }
     }
-  return NULL;
+  intr_set_level (old_level);
+  return found;
+}
+
+/* Adds T, whose tid must be assigned, to the table that
+   thread_find() searches. */
+static void
+tid_table_insert (struct thread *t)
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  list_push_back (&tid_buckets[(unsigned) t->tid % TID_BUCKETS],
+                  &t->tidelem);
+  intr_set_level (old_level);
 }
 
 /* Deschedules the current thread and destroys it.  Never
@@ -316,6 +355,7 @@ thread_exit (void)
      when it calls thread_schedule_tail(). */
   intr_disable ();
   list_remove (&thread_current ()->allelem);
+  list_remove (&thread_current ()->tidelem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -0,0 +1,245 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdio.h>
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Virtually contiguous kernel allocator.
+
+   palloc_get_multiple() can only satisfy a request for several
+   pages if that many physically contiguous pages are free, which
+   becomes unlikely as memory fragments.  vmalloc() instead takes
+   single pages from the page allocator, wherever they are, and
+   maps them next to each other in a range of kernel virtual
+   memory set aside for the purpose, between VMALLOC_START and
+   VMALLOC_END.
+
+   The page tables for the whole range are created by
+   vmalloc_init() and installed in init_page_dir before any
+   other page directory exists.  Because pagedir_create() copies
+   the kernel part of init_page_dir, every page directory shares
+   those page tables, so a mapping made here is immediately
+   visible in every address space.
+
+   Each area is followed by an unmapped guard page, so that
+   running off the end of an area faults instead of silently
+   corrupting the next one.
+
+   Memory from vmalloc() is not physically contiguous, so vtop()
+   does not work on it.  Use vmalloc_to_phys() instead, one page
+   at a time. */
+
+/* An allocated area. */
+struct vm_area
+  {
+    struct list_elem elem;      /* Element in area_list. */
+    uint8_t *addr;              /* First virtual address. */
+    size_t page_cnt;            /* Number of pages mapped. */
+  };
+
+/* Number of pages in the vmalloc range. */
+#define VMALLOC_PAGES (VMALLOC_SIZE / PGSIZE)
+
+static struct lock vmalloc_lock;        /* Protects everything below. */
+static struct bitmap *va_map;           /* Used virtual pages. */
+static struct list area_list;           /* All allocated areas. */
+static size_t mapped_pages;             /* Pages currently mapped. */
+
+static void release_area (struct vm_area *);
+static uint32_t *vmalloc_pte (const void *);
+
+/* Creates the page tables for the vmalloc range.  Must be called
+   after paging_init() and before any other page directory is
+   created. */
+void
+vmalloc_init (void) 
+{
+  uint8_t *va;
+
+  ASSERT (pg_ofs (VMALLOC_START) == 0 && VMALLOC_SIZE % PTSPAN == 0);
+  if ((uint8_t *) ptov (init_ram_pages * PGSIZE - 1)
+      >= (uint8_t *) VMALLOC_START)
+    PANIC ("RAM overlaps vmalloc range");
+
+  for (va = VMALLOC_START; va < (uint8_t *) VMALLOC_END; va += PTSPAN)
+    init_page_dir[pd_no (va)]
+      = pde_create (palloc_get_page (PAL_ASSERT | PAL_ZERO));
+
+  lock_init (&vmalloc_lock);
+  list_init (&area_list);
+  va_map = bitmap_create (VMALLOC_PAGES);
+  if (va_map == NULL)
+    PANIC ("vmalloc_init: out of memory");
+}
+
+/* Obtains SIZE bytes of virtually contiguous kernel memory and
+   returns the address of the first byte, which is page-aligned.
+   Returns a null pointer if SIZE is 0 or if there is not enough
+   physical memory or kernel virtual address space. */
+void *
+vmalloc (size_t size) 
+{
+  size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  struct vm_area *area;
+  size_t page_idx, i;
+
+  if (page_cnt == 0 || page_cnt >= VMALLOC_PAGES)
+    return NULL;
+
+  area = malloc (sizeof *area);
+  if (area == NULL)
+    return NULL;
+
+  /* Reserve virtual pages, plus a guard page. */
+  lock_acquire (&vmalloc_lock);
+  page_idx = bitmap_scan_and_flip (va_map, 0, page_cnt + 1, false);
+  lock_release (&vmalloc_lock);
+  if (page_idx == BITMAP_ERROR)
+    {
+      free (area);
+      return NULL;
+    }
+  area->addr = (uint8_t *) VMALLOC_START + page_idx * PGSIZE;
+  area->page_cnt = page_cnt;
+
+  /* Back them with physical pages. */
+  for (i = 0; i < page_cnt; i++)
+    {
+      void *page = palloc_get_page (0);
+      uint32_t *pte = vmalloc_pte (area->addr + i * PGSIZE);
+
+      if (page == NULL)
+        {
+          release_area (area);
+          return NULL;
+        }
+      ASSERT (*pte == 0);
+      *pte = pte_create_kernel (page, true) | PTE_G;
+    }
+
+  lock_acquire (&vmalloc_lock);
+  list_push_back (&area_list, &area->elem);
+  mapped_pages += page_cnt;
+  lock_release (&vmalloc_lock);
+  return area->addr;
+}
+
+/* Frees the area at P, which must have been returned by
+   vmalloc().  Does nothing if P is a null pointer. */
+void
+vfree (void *p) 
+{
+  struct vm_area *area = NULL;
+  struct list_elem *e;
+
+  if (p == NULL)
+    return;
+
+  lock_acquire (&vmalloc_lock);
+  for (e = list_begin (&area_list); e != list_end (&area_list);
+       e = list_next (e))
+    {
+      struct vm_area *a = list_entry (e, struct vm_area, elem);
+      if (a->addr == p)
+        {
+          area = a;
+          list_remove (&a->elem);
+          mapped_pages -= a->page_cnt;
+          break;
+        }
+    }
+  lock_release (&vmalloc_lock);
+
+  if (area == NULL)
+    PANIC ("vfree: %p was not allocated by vmalloc", p);
+  release_area (area);
+}
+
+/* Returns true if VADDR lies in the vmalloc range. */
+bool
+is_vmalloc_addr (const void *vaddr) 
+{
+  return (const uint8_t *) vaddr >= (const uint8_t *) VMALLOC_START
+         && (const uint8_t *) vaddr < (const uint8_t *) VMALLOC_END;
+}
+
+/* Returns the physical address that VADDR, which must be mapped
+   by vmalloc(), corresponds to. */
+uintptr_t
+vmalloc_to_phys (const void *vaddr) 
+{
+  uint32_t *pte = vmalloc_pte (vaddr);
+
+  ASSERT (*pte & PTE_P);
+  return (*pte & PTE_ADDR) | pg_ofs (vaddr);
+}
+
+/* Returns the physical address of kernel virtual address VADDR,
+   which may lie either in the mapping of RAM or in the vmalloc
+   range. */
+uintptr_t
+kernel_vtop (const void *vaddr)
+{
+  return is_vmalloc_addr (vaddr) ? vmalloc_to_phys (vaddr) : vtop (vaddr);
+}
+
+/* Prints vmalloc statistics. */
+void
+vmalloc_print_stats (void) 
+{
+  lock_acquire (&vmalloc_lock);
+  printf ("Vmalloc: %zu areas, %zu pages mapped, "
+          "%zu of %zu virtual pages reserved\n",
+          list_size (&area_list), mapped_pages,
+          bitmap_count (va_map, 0, VMALLOC_PAGES, true),
+          (size_t) VMALLOC_PAGES);
+  lock_release (&vmalloc_lock);
+}
+
+/* Unmaps and frees the pages of AREA that are mapped, releases
+   its virtual pages, including the guard page, and frees AREA
+   itself. */
+static void
+release_area (struct vm_area *area) 
+{
+  size_t page_idx = (area->addr - (uint8_t *) VMALLOC_START) / PGSIZE;
+  size_t i;
+
+  for (i = 0; i < area->page_cnt; i++)
+    {
+      uint8_t *va = area->addr + i * PGSIZE;
+      uint32_t *pte = vmalloc_pte (va);
+
+      if (!(*pte & PTE_P))
+        continue;
+      palloc_free_page (pte_get_page (*pte));
+      *pte = 0;
+
+      /* The mapping is global, so reloading CR3 would not
+         flush it. */
+      invlpg (va);
+    }
+
+  lock_acquire (&vmalloc_lock);
+  bitmap_set_multiple (va_map, page_idx, area->page_cnt + 1, false);
+  lock_release (&vmalloc_lock);
+  free (area);
+}
+
+/* Returns the page table entry for VADDR, which must lie in the
+   vmalloc range. */
+static uint32_t *
+vmalloc_pte (const void *vaddr) 
+{
+  ASSERT (is_vmalloc_addr (vaddr));
+  return pde_get_pt (init_page_dir[pd_no (vaddr)]) + pt_no (vaddr);
+}
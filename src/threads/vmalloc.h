@@ -0,0 +1,23 @@
+#ifndef THREADS_VMALLOC_H
+#define THREADS_VMALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Kernel virtual address range reserved for vmalloc().
+   It lies well above the direct mapping of RAM, which the loader
+   caps at 64 MB. */
+#define VMALLOC_START ((void *) 0xe0000000)
+#define VMALLOC_SIZE (16 * 1024 * 1024)
+#define VMALLOC_END ((void *) ((uintptr_t) VMALLOC_START + VMALLOC_SIZE))
+
+void vmalloc_init (void);
+void *vmalloc (size_t size);
+void vfree (void *);
+bool is_vmalloc_addr (const void *);
+uintptr_t vmalloc_to_phys (const void *);
+uintptr_t kernel_vtop (const void *);
+void vmalloc_print_stats (void);
+
+#endif /* threads/vmalloc.h */
@@ -0,0 +1,543 @@
+#include "userprog/aio.h"
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "userprog/uaccess.h"
+
+/* Asynchronous I/O.
+
+   A process that calls aio_setup() shares a page of rings with
+   the kernel, laid out as in <aio-ring.h>.  aio_enter() takes
+   requests off the submission ring and either runs them at once,
+   for the cheap ones that change the process's descriptor table
+   (open and close), or hands them to the process's worker
+   threads, for the ones that may wait for the disk or a pipe
+   (read, write, fsync).  Either way the result goes on the
+   completion ring.
+
+   Each process with rings has AIO_WORKERS workers of its own, so
+   a read of an empty pipe can only hold up that process's other
+   requests.  Workers are kept in a pool when their process is
+   done with them, rather than exiting.
+
+   Workers do not run in the process's address space.  They find
+   the user's buffer through the process's page directory and
+   transfer data straight to or from the kernel mapping of each
+   user page.  Each request holds its own reopened file, so
+   closing the descriptor does not disturb requests in flight.
+   Before the process gives up its page directory, aio_exit()
+   drops its queued requests, cancels its pipe transfers, and
+   waits for the rest to finish. */
+
+/* Number of worker threads per process. */
+#define AIO_WORKERS 2
+
+/* A process's asynchronous I/O state. */
+struct aio_context
+  {
+    struct aio_ring *ring;      /* Kernel mapping of the rings. */
+    uint32_t *pagedir;          /* Owning process's page directory. */
+    struct lock lock;           /* Protects the members below. */
+    struct condition done;      /* Signaled on each completion. */
+    struct condition ready;     /* Signaled when a request is queued. */
+    struct list queue;          /* Requests waiting for a worker. */
+    struct list running;        /* Requests being run by a worker. */
+    unsigned inflight;          /* Requests queued or running. */
+    unsigned workers;           /* Workers serving this context. */
+    bool exiting;               /* Is aio_exit() tearing it down? */
+  };
+
+/* A request handed to the workers. */
+struct aio_request
+  {
+    struct list_elem elem;      /* Element in queue or running. */
+    struct aio_context *ctx;    /* Submitting process's context. */
+    struct aio_sqe sqe;         /* Copy of the submission entry. */
+    struct file *file;          /* Private copy of the file. */
+  };
+
+/* A worker thread. */
+struct aio_worker
+  {
+    struct list_elem elem;      /* Element in idle_workers. */
+    struct aio_context *ctx;    /* Context to serve next. */
+    struct semaphore assigned;  /* Up'd when CTX is set. */
+  };
+
+/* Workers not serving any context. */
+static struct list idle_workers;
+static struct lock workers_lock;
+
+static thread_func aio_worker NO_RETURN;
+
+/* Initializes the asynchronous I/O system. */
+void
+aio_init (void)
+{
+  list_init (&idle_workers);
+  lock_init (&workers_lock);
+}
+
+/* Assigns an idle worker to CTX, starting a new one if none is
+   idle.  Returns false if a new one cannot be started. */
+static bool
+assign_worker (struct aio_context *ctx)
+{
+  struct aio_worker *w;
+
+  lock_acquire (&workers_lock);
+  if (!list_empty (&idle_workers))
+    w = list_entry (list_pop_front (&idle_workers), struct aio_worker, elem);
+  else
+    {
+      w = malloc (sizeof *w);
+      if (w != NULL)
+        {
+          sema_init (&w->assigned, 0);
+          if (thread_create ("aio", PRI_DEFAULT, aio_worker, w) == TID_ERROR)
+            {
+              free (w);
+              w = NULL;
+            }
+        }
+    }
+  lock_release (&workers_lock);
+
+  if (w == NULL)
+    return false;
+  ctx->workers++;
+  w->ctx = ctx;
+  sema_up (&w->assigned);
+  return true;
+}
+
+/* Maps a zeroed page of rings into the running process at
+   AIO_RING_ADDR and returns that address, or a null pointer if
+   the process already has rings or memory is short. */
+struct aio_ring *
+aio_setup (void)
+{
+  struct process *p = process_current ();
+  uint32_t *pd = thread_current ()->pagedir;
+  struct aio_context *ctx;
+  int i;
+
+  if (p->aio != NULL)
+    return NULL;
+
+  ctx = malloc (sizeof *ctx);
+  if (ctx == NULL)
+    return NULL;
+  ctx->ring = palloc_get_page (PAL_USER | PAL_ZERO);
+  if (ctx->ring == NULL
+      || pagedir_get_page (pd, AIO_RING_ADDR) != NULL
+      || !pagedir_set_page (pd, AIO_RING_ADDR, ctx->ring, true))
+    {
+      palloc_free_page (ctx->ring);
+      free (ctx);
+      return NULL;
+    }
+  ctx->pagedir = pd;
+  lock_init (&ctx->lock);
+  cond_init (&ctx->done);
+  cond_init (&ctx->ready);
+  list_init (&ctx->queue);
+  list_init (&ctx->running);
+  ctx->inflight = 0;
+  ctx->workers = 0;
+  ctx->exiting = false;
+
+  /* Any worker at all will do. */
+  for (i = 0; i < AIO_WORKERS; i++)
+    if (!assign_worker (ctx))
+      break;
+  p->aio = ctx;
+  if (ctx->workers == 0)
+    {
+      aio_exit ();
+      return NULL;
+    }
+  return AIO_RING_ADDR;
+}
+
+/* Posts a completion with USER_DATA and RES on CTX's completion
+   ring.  The caller must hold CTX's lock and have made sure there
+   is room. */
+static void
+post_completion (struct aio_context *ctx, uint32_t user_data, int32_t res)
+{
+  struct aio_ring *ring = ctx->ring;
+  struct aio_cqe *cqe = &ring->cq[ring->cq_tail % AIO_RING_ENTRIES];
+
+  ASSERT (lock_held_by_current_thread (&ctx->lock));
+
+  cqe->user_data = user_data;
+  cqe->res = res;
+  barrier ();
+  ring->cq_tail++;
+  cond_broadcast (&ctx->done, &ctx->lock);
+}
+
+/* Posts a completion for a request run by the submitting
+   process itself. */
+static void
+complete_now (struct aio_context *ctx, const struct aio_sqe *sqe,
+              int32_t res)
+{
+  lock_acquire (&ctx->lock);
+  post_completion (ctx, sqe->user_data, res);
+  lock_release (&ctx->lock);
+}
+
+/* Opens the file named by SQE's buffer, returning a new file
+   descriptor or -1. */
+static int32_t
+run_open (const struct aio_sqe *sqe)
+{
+  char *name = palloc_get_page (0);
+  struct file *file = NULL;
+  int fd = -1;
+  int len;
+
+  if (name == NULL)
+    return -1;
+  len = strncpy_from_user (name, sqe->buf, PGSIZE);
+  if (len >= 0 && len < PGSIZE)
+    file = filesys_open (name);
+  palloc_free_page (name);
+
+  if (file != NULL)
+    {
+      fd = process_allocate_fd (file);
+      if (fd < 0)
+        file_close (file);
+    }
+  return fd;
+}
+
+/* Closes SQE's file descriptor, returning 0 or -1. */
+static int32_t
+run_close (const struct aio_sqe *sqe)
+{
+  struct file *file = process_get_file (sqe->fd);
+
+  if (file == NULL)
+    return -1;
+  process_free_fd (sqe->fd);
+  file_close (file);
+  return 0;
+}
+
+/* Hands the read, write, or fsync request in SQE to the workers.
+   Returns false if it cannot, because its file descriptor or
+   buffer is bad, it would read or write a directory's raw
+   entries, or memory is short. */
+static bool
+queue_request (struct aio_context *ctx, const struct aio_sqe *sqe)
+{
+  struct file *file = process_get_file (sqe->fd);
+  struct aio_request *req;
+
+  if (file == NULL)
+    return false;
+  if (sqe->opcode != AIO_FSYNC
+      && (file_is_dir (file)
+          || (sqe->offset < 0 && !file_is_pipe (file))
+          || !probe_user (sqe->buf, sqe->len, sqe->opcode == AIO_READ)))
+    return false;
+
+  req = malloc (sizeof *req);
+  if (req == NULL)
+    return false;
+  req->file = file_reopen (file);
+  if (req->file == NULL)
+    {
+      free (req);
+      return false;
+    }
+  req->ctx = ctx;
+  req->sqe = *sqe;
+
+  lock_acquire (&ctx->lock);
+  ctx->inflight++;
+  list_push_back (&ctx->queue, &req->elem);
+  cond_signal (&ctx->ready, &ctx->lock);
+  lock_release (&ctx->lock);
+  return true;
+}
+
+/* Submits the request in SQE. */
+static void
+submit (struct aio_context *ctx, const struct aio_sqe *sqe)
+{
+  switch (sqe->opcode)
+    {
+    case AIO_OPEN:
+      complete_now (ctx, sqe, run_open (sqe));
+      break;
+
+    case AIO_CLOSE:
+      complete_now (ctx, sqe, run_close (sqe));
+      break;
+
+    case AIO_READ:
+    case AIO_WRITE:
+    case AIO_FSYNC:
+      if (!queue_request (ctx, sqe))
+        complete_now (ctx, sqe, -1);
+      break;
+
+    default:
+      complete_now (ctx, sqe, -1);
+      break;
+    }
+}
+
+/* Returns true if CTX's completion ring has room for every
+   request in flight plus one more. */
+static bool
+have_room (struct aio_context *ctx)
+{
+  struct aio_ring *ring = ctx->ring;
+  bool room;
+
+  lock_acquire (&ctx->lock);
+  room = ring->cq_tail - ring->cq_head + ctx->inflight < AIO_RING_ENTRIES;
+  lock_release (&ctx->lock);
+  return room;
+}
+
+/* Submits up to TO_SUBMIT requests from the running process's
+   submission ring, then waits until at least MIN_COMPLETE
+   completions are waiting to be reaped, or no requests are in
+   flight.  Stops submitting early if the submission ring is empty
+   or the completion ring could not take another completion.
+   Returns the number of requests submitted, or -1 if the process
+   has no rings. */
+int
+aio_enter (unsigned to_submit, unsigned min_complete)
+{
+  struct aio_context *ctx = process_current ()->aio;
+  struct aio_ring *ring;
+  unsigned submitted = 0;
+
+  if (ctx == NULL)
+    return -1;
+  ring = ctx->ring;
+
+  while (submitted < to_submit && ring->sq_head != ring->sq_tail
+         && have_room (ctx))
+    {
+      /* Copy the entry first: the process may change it under us. */
+      struct aio_sqe sqe = ring->sq[ring->sq_head % AIO_RING_ENTRIES];
+      barrier ();
+      ring->sq_head++;
+      submit (ctx, &sqe);
+      submitted++;
+    }
+
+  if (min_complete > AIO_RING_ENTRIES)
+    min_complete = AIO_RING_ENTRIES;
+  lock_acquire (&ctx->lock);
+  while (ctx->inflight > 0 && ring->cq_tail - ring->cq_head < min_complete)
+    cond_wait (&ctx->done, &ctx->lock);
+  lock_release (&ctx->lock);
+
+  return submitted;
+}
+
+/* Transfers the data of read or write request REQ between its
+   file and the user's buffer, a page at a time.  Returns the
+   number of bytes transferred, or -1 if none could be. */
+static int32_t
+run_transfer (struct aio_request *req)
+{
+  uint8_t *ubuf = req->sqe.buf;
+  size_t left = req->sqe.len;
+  off_t ofs = req->sqe.offset;
+  bool pipe = file_is_pipe (req->file);
+  int32_t total = 0;
+
+  while (left > 0)
+    {
+      size_t chunk = PGSIZE - pg_ofs (ubuf);
+      uint8_t *kbuf = pagedir_get_page (req->ctx->pagedir, ubuf);
+      off_t n;
+
+      if (chunk > left)
+        chunk = left;
+      if (kbuf == NULL)
+        break;
+
+      if (req->sqe.opcode == AIO_READ)
+        n = (pipe ? file_read (req->file, kbuf, chunk)
+             : file_read_at (req->file, kbuf, chunk, ofs));
+      else
+        n = (pipe ? file_write (req->file, kbuf, chunk)
+             : file_write_at (req->file, kbuf, chunk, ofs));
+      if (n <= 0)
+        break;
+
+      total += n;
+      ubuf += n;
+      ofs += n;
+      left -= n;
+      if ((size_t) n < chunk)
+        break;
+    }
+  return total > 0 || req->sqe.len == 0 ? total : -1;
+}
+
+/* Runs CTX's queued requests and posts their completions, until
+   CTX is being torn down and has none left. */
+static void
+serve (struct aio_context *ctx)
+{
+  lock_acquire (&ctx->lock);
+  for (;;)
+    {
+      struct aio_request *req;
+      int32_t res;
+
+      while (list_empty (&ctx->queue) && !ctx->exiting)
+        cond_wait (&ctx->ready, &ctx->lock);
+      if (list_empty (&ctx->queue))
+        break;
+      req = list_entry (list_pop_front (&ctx->queue),
+                        struct aio_request, elem);
+      list_push_back (&ctx->running, &req->elem);
+      lock_release (&ctx->lock);
+
+      if (req->sqe.opcode == AIO_FSYNC)
+        res = file_sync (req->file, false) ? 0 : -1;
+      else
+        res = run_transfer (req);
+
+      /* Leave RUNNING before closing the file, which aio_exit()
+         may be cancelling. */
+      lock_acquire (&ctx->lock);
+      list_remove (&req->elem);
+      lock_release (&ctx->lock);
+      file_close (req->file);
+
+      lock_acquire (&ctx->lock);
+      post_completion (ctx, req->sqe.user_data, res);
+      ctx->inflight--;
+      free (req);
+    }
+  ctx->workers--;
+  cond_broadcast (&ctx->done, &ctx->lock);
+  lock_release (&ctx->lock);
+}
+
+/* A worker thread, W_: serves the contexts it is assigned, one
+   at a time, forever. */
+static void
+aio_worker (void *w_)
+{
+  struct aio_worker *w = w_;
+
+  for (;;)
+    {
+      sema_down (&w->assigned);
+      serve (w->ctx);
+
+      lock_acquire (&workers_lock);
+      list_push_back (&idle_workers, &w->elem);
+      lock_release (&workers_lock);
+    }
+}
+
+/* Returns true if REQ reads or writes the SIZE bytes of user
+   memory at ADDR, or any of them. */
+static bool
+overlaps (const struct aio_request *req, const uint8_t *addr, size_t size)
+{
+  const uint8_t *buf = req->sqe.buf;
+
+  return (req->sqe.opcode != AIO_FSYNC
+          && buf < addr + size && addr < buf + req->sqe.len);
+}
+
+/* Returns true if any of the running process's requests that are
+   queued or running transfers to or from the SIZE bytes of user
+   memory at ADDR.  Such memory must stay mapped, because the
+   workers hold on to its kernel addresses. */
+bool
+aio_busy (const void *addr, size_t size)
+{
+  struct aio_context *ctx = process_current ()->aio;
+  struct list *lists[2];
+  bool busy = false;
+  int i;
+
+  if (ctx == NULL)
+    return false;
+
+  lists[0] = &ctx->queue;
+  lists[1] = &ctx->running;
+  lock_acquire (&ctx->lock);
+  for (i = 0; i < 2 && !busy; i++)
+    {
+      struct list_elem *e;
+
+      for (e = list_begin (lists[i]); e != list_end (lists[i]);
+           e = list_next (e))
+        if (overlaps (list_entry (e, struct aio_request, elem), addr, size))
+          {
+            busy = true;
+            break;
+          }
+    }
+  lock_release (&ctx->lock);
+  return busy;
+}
+
+/* Cancels the running process's queued requests, cuts short
+   its pipe transfers in flight, which could otherwise wait for
+   the process itself, and waits for the rest to finish.  Then
+   returns its workers to the pool and unmaps and frees its
+   rings.  Must be called before the process's
+   page directory is destroyed. */
+void
+aio_exit (void)
+{
+  struct process *p = process_current ();
+  struct aio_context *ctx = p->aio;
+  struct list_elem *e;
+
+  if (ctx == NULL)
+    return;
+
+  lock_acquire (&ctx->lock);
+  ctx->exiting = true;
+  while (!list_empty (&ctx->queue))
+    {
+      struct aio_request *req = list_entry (list_pop_front (&ctx->queue),
+                                            struct aio_request, elem);
+      file_close (req->file);
+      free (req);
+      ctx->inflight--;
+    }
+  for (e = list_begin (&ctx->running); e != list_end (&ctx->running);
+       e = list_next (e))
+    file_cancel (list_entry (e, struct aio_request, elem)->file);
+  cond_broadcast (&ctx->ready, &ctx->lock);
+  while (ctx->workers > 0)
+    cond_wait (&ctx->done, &ctx->lock);
+  lock_release (&ctx->lock);
+
+  pagedir_clear_page (ctx->pagedir, AIO_RING_ADDR);
+  palloc_free_page (ctx->ring);
+  free (ctx);
+  p->aio = NULL;
+}
@@ -0,0 +1,18 @@
+#ifndef USERPROG_AIO_H
+#define USERPROG_AIO_H
+
+#include <aio-ring.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* User address at which aio_setup() maps a process's rings, just
+   above the shared memory area. */
+#define AIO_RING_ADDR ((void *) 0x80000000)
+
+void aio_init (void);
+struct aio_ring *aio_setup (void);
+int aio_enter (unsigned to_submit, unsigned min_complete);
+void aio_exit (void);
+bool aio_busy (const void *addr, size_t size);
+
+#endif /* userprog/aio.h */
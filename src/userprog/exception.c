@@ -5,6 +5,7 @@
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
+#include "userprog/uaccess.h"
 #include "utils/colors.h"
 #include <inttypes.h>
 #include <kernel/debug.h>
@@ -162,6 +163,23 @@ page_fault (struct intr_frame *f)
                fault_addr, not_present ? "not present" : "rights violation",
                write ? "writing" : "reading", user ? "user" : "kernel");
 
+  if (!user)
+    {
+      /* The kernel may fault on purpose when it accesses user
+         memory through the functions in uaccess.c.  Resume at
+         the instruction's fixup code, which reports the error. */
+      void *fixup = search_exception_table ((void *) f->eip);
+      if (fixup != NULL)
+        {
+          f->eip = (void (*) (void)) fixup;
+          return;
+        }
+
+      DEBUG_PRINT (COLOR_MAG "Kernel page fault.");
+      if (is_kernel_vaddr (fault_addr))
+        kill (f);
+    }
+
   /* Always fail if rights violation occurs. */
   if (!not_present)
     {
@@ -169,18 +187,6 @@ page_fault (struct intr_frame *f)
       thread_exit ();
     }
 
-  if (!user)
-    {
-      DEBUG_PRINT (COLOR_MAG "Kernel page fault.");
-
-      /* Set eip to eax value */
-      f->eip = (void *)f->eax;
-      /* Set eax to 0xffffffff to indicate page fault. */
-      f->eax = 0xffffffff;
-
-      return;
-    }
-
   DEBUG_PRINT (COLOR_MAG "User page fault.");
   thread_exit ();
 }
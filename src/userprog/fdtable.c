@@ -0,0 +1,242 @@
+#include "userprog/fdtable.h"
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+#include "threads/malloc.h"
+
+/* File descriptor tables.
+
+   A table is a directory of fixed-size chunks.  Each chunk holds
+   FD_CHUNK_SIZE open files and a word with one bit per slot, set
+   if the slot is in use.  A summary bitmap, FULL, has one bit
+   per chunk, set if every slot in the chunk is in use.
+
+   To allocate the lowest free descriptor, we find the first
+   chunk that is not full with the summary bitmap, then the first
+   free slot in that chunk with its USED word, each a
+   find-first-zero over 32-bit words.  Only when every chunk is
+   full do we add a chunk.  Adding a chunk never moves the open
+   files, only the directory of chunk pointers and the summary
+   bitmap, which are FD_CHUNK_SIZE and FD_CHUNK_SIZE**2 times
+   smaller than the table.
+
+   Descriptors 0 and 1 are reserved for the console, so they are
+   marked in use from the start, with no file.  A file may be
+   installed there to redirect standard input or output; removing
+   it returns the descriptor to the console. */
+
+/* Number of bits in a bitmap word. */
+#define WORD_BITS 32
+
+/* Returns the index of the lowest clear bit in WORD, which must
+   not be all ones. */
+static inline int
+first_zero (uint32_t word)
+{
+  ASSERT (word != UINT32_MAX);
+  return __builtin_ctz (~word);
+}
+
+/* Returns the number of words in the summary bitmap of a table
+   with CHUNK_CNT chunks. */
+static inline size_t
+full_words (size_t chunk_cnt)
+{
+  return DIV_ROUND_UP (chunk_cnt, WORD_BITS);
+}
+
+/* Initializes T as an empty table. */
+void
+fdtable_init (struct fd_table *t)
+{
+  t->chunks = NULL;
+  t->full = NULL;
+  t->chunk_cnt = 0;
+  t->chunk_cap = 0;
+}
+
+/* Frees the memory used by T.  Does not close any files. */
+void
+fdtable_destroy (struct fd_table *t)
+{
+  size_t i;
+
+  for (i = 0; i < t->chunk_cnt; i++)
+    free (t->chunks[i]);
+  free (t->chunks);
+  free (t->full);
+  fdtable_init (t);
+}
+
+/* Adds an empty chunk to T.  Returns true if successful, false
+   on memory allocation failure. */
+static bool
+add_chunk (struct fd_table *t)
+{
+  size_t new_cnt = t->chunk_cnt + 1;
+  struct fd_chunk *c;
+
+  /* Grow the directory and the summary bitmap first, so that a
+     failure leaves T unchanged. */
+  if (new_cnt > t->chunk_cap)
+    {
+      size_t new_cap = t->chunk_cap > 0 ? 2 * t->chunk_cap : 1;
+      struct fd_chunk **chunks = realloc (t->chunks,
+                                          new_cap * sizeof *chunks);
+      if (chunks == NULL)
+        return false;
+      t->chunks = chunks;
+      t->chunk_cap = new_cap;
+    }
+  if (full_words (new_cnt) > full_words (t->chunk_cnt))
+    {
+      uint32_t *full = realloc (t->full,
+                                full_words (new_cnt) * sizeof *full);
+      if (full == NULL)
+        return false;
+      full[full_words (new_cnt) - 1] = 0;
+      t->full = full;
+    }
+
+  c = calloc (1, sizeof *c);
+  if (c == NULL)
+    return false;
+  if (t->chunk_cnt == 0)
+    c->used = (1u << 0) | (1u << 1);
+  t->chunks[t->chunk_cnt++] = c;
+  return true;
+}
+
+/* Installs FILE at the lowest free descriptor in T and returns
+   the descriptor, or -1 if memory allocation fails. */
+int
+fdtable_alloc (struct fd_table *t, struct file *file)
+{
+  size_t w, ci;
+  struct fd_chunk *c;
+  int slot;
+
+  ASSERT (file != NULL);
+
+  /* Find the first chunk that is not full. */
+  for (w = 0; w < full_words (t->chunk_cnt); w++)
+    if (t->full[w] != UINT32_MAX)
+      break;
+  ci = w * WORD_BITS;
+  if (w < full_words (t->chunk_cnt))
+    ci += first_zero (t->full[w]);
+  if (ci >= t->chunk_cnt)
+    {
+      if (!add_chunk (t))
+        return -1;
+      ci = t->chunk_cnt - 1;
+    }
+
+  /* Take its first free slot. */
+  c = t->chunks[ci];
+  slot = first_zero (c->used);
+  c->used |= 1u << slot;
+  c->files[slot] = file;
+  if (c->used == UINT32_MAX)
+    t->full[ci / WORD_BITS] |= 1u << (ci % WORD_BITS);
+
+  return ci * FD_CHUNK_SIZE + slot;
+}
+
+/* Installs FILE as descriptor FD in T, which need not be free,
+   and stores the file previously open as FD, or a null pointer,
+   into *OLD.  Returns true if successful, false if FD is out of
+   range or memory allocation fails. */
+bool
+fdtable_install (struct fd_table *t, int fd, struct file *file,
+                 struct file **old)
+{
+  struct fd_chunk *c;
+  size_t ci;
+  int slot;
+
+  ASSERT (file != NULL);
+
+  if (fd < 0 || fd > FD_INSTALL_MAX)
+    return false;
+  ci = fd / FD_CHUNK_SIZE;
+  while (ci >= t->chunk_cnt)
+    if (!add_chunk (t))
+      return false;
+
+  slot = fd % FD_CHUNK_SIZE;
+  c = t->chunks[ci];
+  *old = c->files[slot];
+  c->used |= 1u << slot;
+  c->files[slot] = file;
+  if (c->used == UINT32_MAX)
+    t->full[ci / WORD_BITS] |= 1u << (ci % WORD_BITS);
+  return true;
+}
+
+/* Returns the file open as FD in T, or a null pointer if FD is
+   not open. */
+struct file *
+fdtable_get (const struct fd_table *t, int fd)
+{
+  size_t ci;
+
+  if (fd < 0)
+    return NULL;
+  ci = fd / FD_CHUNK_SIZE;
+  if (ci >= t->chunk_cnt)
+    return NULL;
+  return t->chunks[ci]->files[fd % FD_CHUNK_SIZE];
+}
+
+/* Frees descriptor FD in T and returns the file that was open
+   as FD, or a null pointer if FD was not open. */
+struct file *
+fdtable_remove (struct fd_table *t, int fd)
+{
+  struct file *file = fdtable_get (t, fd);
+  struct fd_chunk *c;
+  size_t ci;
+  int slot;
+
+  if (file == NULL)
+    return NULL;
+
+  ci = fd / FD_CHUNK_SIZE;
+  slot = fd % FD_CHUNK_SIZE;
+  c = t->chunks[ci];
+  c->files[slot] = NULL;
+  if (fd > 1)
+    {
+      c->used &= ~(1u << slot);
+      t->full[ci / WORD_BITS] &= ~(1u << (ci % WORD_BITS));
+    }
+  return file;
+}
+
+/* Returns the lowest descriptor at least FD that has a file open
+   in T, or -1 if there is none.  Iterate over all the open files
+   in T with:
+
+     for (fd = fdtable_next (t, 0); fd >= 0;
+          fd = fdtable_next (t, fd + 1))
+       ...
+*/
+int
+fdtable_next (const struct fd_table *t, int fd)
+{
+  size_t ci;
+
+  if (fd < 0)
+    fd = 0;
+  for (ci = fd / FD_CHUNK_SIZE; ci < t->chunk_cnt; ci++)
+    {
+      const struct fd_chunk *c = t->chunks[ci];
+      int slot = ci == (size_t) fd / FD_CHUNK_SIZE ? fd % FD_CHUNK_SIZE : 0;
+
+      for (; slot < FD_CHUNK_SIZE; slot++)
+        if (c->files[slot] != NULL)
+          return ci * FD_CHUNK_SIZE + slot;
+    }
+  return -1;
+}
@@ -0,0 +1,41 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Number of file descriptors per chunk, one per bit of a
+   chunk's USED word. */
+#define FD_CHUNK_SIZE 32
+
+/* Largest descriptor fdtable_install() accepts, which bounds how
+   far it grows a table. */
+#define FD_INSTALL_MAX 1023
+
+/* A chunk of a file descriptor table. */
+struct fd_chunk
+  {
+    uint32_t used;                      /* Bit I set if fd I is in use. */
+    struct file *files[FD_CHUNK_SIZE];  /* Open files. */
+  };
+
+/* A file descriptor table. */
+struct fd_table
+  {
+    struct fd_chunk **chunks;   /* Chunks, FD_CHUNK_SIZE fds each. */
+    uint32_t *full;             /* Bit I set if chunk I is full. */
+    size_t chunk_cnt;           /* Number of chunks. */
+    size_t chunk_cap;           /* Capacity of CHUNKS. */
+  };
+
+void fdtable_init (struct fd_table *);
+void fdtable_destroy (struct fd_table *);
+int fdtable_alloc (struct fd_table *, struct file *);
+bool fdtable_install (struct fd_table *, int fd, struct file *,
+                      struct file **old);
+struct file *fdtable_get (const struct fd_table *, int fd);
+struct file *fdtable_remove (struct fd_table *, int fd);
+int fdtable_next (const struct fd_table *, int fd);
+
+#endif /* userprog/fdtable.h */
@@ -89,8 +89,8 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
    UPAGE to the physical frame identified by kernel virtual
    address KPAGE.
    UPAGE must not already be mapped.
-   KPAGE should probably be a page obtained from the user pool
-   with palloc_get_page().
+   KPAGE should probably be a user page, obtained
+   with palloc_get_page (PAL_USER).
    If WRITABLE is true, the new page is read/write;
    otherwise it is read-only.
    Returns true if successful, false if memory allocation
@@ -10,8 +10,10 @@
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/aio.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/shm.h"
 #include "userprog/tss.h"
 #include <debug.h>
 #include <inttypes.h>
@@ -24,6 +26,21 @@
 static thread_func start_process NO_RETURN;
 static bool load (char *cmdline, void (**eip) (void), void **esp);
 static void init_process (struct process *p);
+static bool inherit_pipes (struct process *child, struct process *parent);
+
+/* Hash table of all live processes, keyed by pid.  A process is
+   removed once its parent can no longer wait for it, before it is
+   freed, so a pointer found under pid_lock is valid for as long
+   as the caller is that parent. */
+#define PID_BUCKETS 64
+static struct list pid_buckets[PID_BUCKETS];
+static struct lock pid_lock;
+
+static struct list *
+pid_bucket (pid_t pid)
+{
+  return &pid_buckets[(unsigned) pid % PID_BUCKETS];
+}
 
 /* Convert thread indentifier to process identifier. */
 pid_t
@@ -58,10 +75,14 @@ process_execute (const char *file_name)
     return TID_ERROR;
   strlcpy (fn_copy, file_name, PGSIZE);
 
-  /* Create a new thread to execute FILE_NAME. */
+  /* Create a new thread to execute FILE_NAME.  It waits in
+     start_process() until we have set it up. */
   tid = thread_create (file_name, PRI_DEFAULT, start_process, fn_copy);
   if (tid == TID_ERROR)
-    palloc_free_page (fn_copy);
+    {
+      palloc_free_page (fn_copy);
+      return TID_ERROR;
+    }
 
   struct thread *cur = thread_current ();
   struct thread *t = thread_find (tid);
@@ -76,10 +97,45 @@ process_execute (const char *file_name)
       t->process->current_dir = dir;
     }
 
+  /* The child only loads if it inherits all our pipes. */
+  t->process->load_success = inherit_pipes (t->process, cur->process);
+
   list_push_back (&(cur->process->chilren), &(t->process->child_elem));
+  sema_up (&t->process->start_sema);
   return tid;
 }
 
+/* Opens each pipe end open in PARENT as the same descriptor in
+   CHILD, so that a pipeline set up with pipe() and dup2() before
+   exec() reaches the new process.  Ordinary files are not
+   inherited.  Returns true if successful, false if memory is
+   short. */
+static bool
+inherit_pipes (struct process *child, struct process *parent)
+{
+  int fd;
+
+  for (fd = fdtable_next (&parent->fds, 0); fd >= 0;
+       fd = fdtable_next (&parent->fds, fd + 1))
+    {
+      struct file *file = fdtable_get (&parent->fds, fd);
+      struct file *copy, *old;
+
+      if (!file_is_pipe (file))
+        continue;
+      copy = file_reopen (file);
+      if (copy == NULL)
+        return false;
+      if (!fdtable_install (&child->fds, fd, copy, &old))
+        {
+          file_close (copy);
+          return false;
+        }
+      ASSERT (old == NULL);
+    }
+  return true;
+}
+
 /* A thread function that loads a user process and starts it
    running. */
 static void
@@ -90,12 +146,16 @@ start_process (void *file_name_)
   struct thread *t = thread_current ();
   struct process *p = t->process;
 
+  /* Wait for process_execute() to set us up. */
+  sema_down (&p->start_sema);
+
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
-  p->load_success = load (file_name, &if_.eip, &if_.esp);
+  p->load_success = (p->load_success
+                     && load (file_name, &if_.eip, &if_.esp));
   sema_up (&p->load_sema);
 
   /* If load failed, quit. */
@@ -152,6 +212,11 @@ process_exit (void)
   /* Print the process's name and exit code. */
   printf ("%s: exit(%d)\n", p->name, p->exit_code);
 
+  /* Finish asynchronous I/O, which uses the page directory, and
+     unmap shared memory, which the page directory does not own. */
+  aio_exit ();
+  shm_exit ();
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = t->pagedir;
@@ -180,6 +245,11 @@ process_exit (void)
       list_remove (&(p->child_elem));
     }
 
+  /* Nobody can wait for us any more. */
+  lock_acquire (&pid_lock);
+  list_remove (&p->pid_elem);
+  lock_release (&pid_lock);
+
   /* Set children's parent to NULL */
   struct list_elem *e;
   for (e = list_begin (&p->chilren); e != list_end (&p->chilren);
@@ -190,16 +260,12 @@ process_exit (void)
     }
 
   /* Close all opened files */
-  for (int fd = 2; fd < p->fd_count; fd++)
-    {
-      if (p->fd_table[fd] == NULL)
-        continue;
-      file_close (p->fd_table[fd]);
-      process_free_fd (fd);
-    }
+  for (int fd = fdtable_next (&p->fds, 0); fd >= 0;
+       fd = fdtable_next (&p->fds, fd + 1))
+    file_close (fdtable_remove (&p->fds, fd));
 
   /* Free fd table */
-  free (p->fd_table);
+  fdtable_destroy (&p->fds);
 
   file_close (p->executable);
   dir_close (p->current_dir);
@@ -630,8 +696,8 @@ setup_stack (void **esp)
    If WRITABLE is true, the user process may modify the page;
    otherwise, it is read-only.
    UPAGE must not already be mapped.
-   KPAGE should probably be a page obtained from the user pool
-   with palloc_get_page().
+   KPAGE should probably be a user page, obtained
+   with palloc_get_page (PAL_USER).
    Returns true on success, false if UPAGE is already mapped or
    if memory allocation fails. */
 static bool
@@ -645,24 +711,31 @@ install_page (void *upage, void *kpage, bool writable)
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
 
-/* Returns the process with ID pid in children, or NULL if no such thread
-   exists. */
+/* Returns the child of the running process with ID pid, or NULL
+   if no such child exists. */
 struct process *
 process_find (pid_t pid)
 {
+  struct list *bucket = pid_bucket (pid);
+  struct process *found = NULL;
   struct list_elem *e;
 
   struct process *cur = process_current ();
   ASSERT (cur != NULL);
 
-  for (e = list_begin (&cur->chilren); e != list_end (&cur->chilren);
-       e = list_next (e))
+  lock_acquire (&pid_lock);
+  for (e = list_begin (bucket); e != list_end (bucket); e = list_next (e))
     {
-      struct process *p = list_entry (e, struct process, child_elem);
+      struct process *p = list_entry (e, struct process, pid_elem);
       if (p->pid == pid)
-        return p;
+        {
+          if (p->parent == cur)
+            found = p;
+          break;
+        }
     }
-  return NULL;
+  lock_release (&pid_lock);
+  return found;
 }
 
 void
@@ -670,6 +743,10 @@ process_init (void)
 {
   ASSERT (intr_get_level () == INTR_OFF);
 
+  lock_init (&pid_lock);
+  for (size_t i = 0; i < PID_BUCKETS; i++)
+    list_init (&pid_buckets[i]);
+
   struct thread *t = thread_current ();
   pid_t p = process_create (t);
 
@@ -694,6 +771,10 @@ process_create (struct thread *t)
   t->process = p;
   p->pid = t->tid;
 
+  lock_acquire (&pid_lock);
+  list_push_back (pid_bucket (p->pid), &p->pid_elem);
+  lock_release (&pid_lock);
+
   return p->pid;
 }
 
@@ -705,18 +786,19 @@ init_process (struct process *p)
 
   p->exit_code = -1;
   /* Initialize the file descriptor table. */
-  p->fd_table = NULL;
-  /* Set the initial file descriptor table size to 2 because
-    stdin and stdout are reserved. */
-  p->fd_count = 2;
+  fdtable_init (&p->fds);
+  list_init (&p->shm_refs);
+  p->aio = NULL;
   /* Initialize the thread children list. */
   list_init (&(p->chilren));
 
+  sema_init (&(p->start_sema), 0);
   sema_init (&(p->load_sema), 0);
   sema_init (&(p->wait_sema), 0);
   sema_init (&(p->exit_sema), 0);
 
   p->parent = NULL;
+  p->load_success = false;
   p->executable = NULL;
   p->current_dir = NULL;
 }
@@ -741,61 +823,36 @@ process_current (void)
 int
 process_allocate_fd (struct file *file)
 {
-  struct process *p = process_current ();
-  int fd;
-
-  /* Find an unused file descriptor in current fd_table. */
-  for (fd = 2; fd < p->fd_count; fd++)
-    {
-      if (p->fd_table[fd] == NULL)
-        {
-          p->fd_table[fd] = file;
-          return fd;
-        }
-    }
-
-  /* Try to extend fd_table if there is no unused fd. */
-  ASSERT (fd == p->fd_count)
-  int new_fd_count = p->fd_count * 2;
-  ASSERT (new_fd_count > p->fd_count);
-  struct file **new_fd_table
-      = realloc (p->fd_table, new_fd_count * sizeof (struct file *));
-  if (new_fd_table == NULL)
-    return -1;
-  memset (new_fd_table + p->fd_count, 0,
-          (new_fd_count - p->fd_count) * sizeof (struct file *));
-  p->fd_table = new_fd_table;
-  p->fd_count = new_fd_count;
-
-  /* Set file descriptor to new fd_table. */
-  ASSERT (p->fd_table[fd] == NULL);
-  p->fd_table[fd] = file;
-  return fd;
+  return fdtable_alloc (&process_current ()->fds, file);
 }
 
 /* Get file for FD. */
 struct file *
 process_get_file (int fd)
 {
-  struct process *p = process_current ();
-  if (fd < 2 || fd >= p->fd_count)
-    return NULL;
+  return fdtable_get (&process_current ()->fds, fd);
+}
 
-  ASSERT (fd >= 2 && fd < p->fd_count);
-  struct file *file = p->fd_table[fd];
+/* Installs FILE as descriptor FD, which need not be free, and
+   closes the file previously open as FD, if any.  Returns true if
+   successful, false on failure, in which case FILE stays open. */
+bool
+process_install_fd (int fd, struct file *file)
+{
+  struct file *old;
 
-  // ASSERT (file != NULL);
-  return file;
+  if (!fdtable_install (&process_current ()->fds, fd, file, &old))
+    return false;
+  file_close (old);
+  return true;
 }
 
 /* Free file descriptor FD. */
 void
 process_free_fd (int fd)
 {
-  struct process *p = process_current ();
-  ASSERT (fd >= 2 && fd < p->fd_count);
-  ASSERT (p->fd_table[fd] != NULL);
-  p->fd_table[fd] = NULL;
+  struct file *file UNUSED = fdtable_remove (&process_current ()->fds, fd);
+  ASSERT (file != NULL);
 }
 
 bool
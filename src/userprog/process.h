@@ -8,6 +8,9 @@ typedef int pid_t;
 #include "filesys/directory.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "userprog/fdtable.h"
+
+struct aio_context;
 
 struct process
 {
@@ -17,15 +20,20 @@ struct process
   pid_t pid;     /* Process Id */
   int exit_code; /* Exit status. */
 
-  struct file **fd_table; /* File descriptor table. */
-  int fd_count;           /* Number of open files. */
+  struct fd_table fds; /* File descriptor table. */
+  struct list shm_refs; /* References to shared memory segments. */
+  struct aio_context *aio; /* Asynchronous I/O rings, if set up. */
 
   struct process *parent;      /* Parent process. */
   struct list chilren;         /* List of child processes. */
   struct list_elem child_elem; /* List element for children list. */
+  struct list_elem pid_elem;   /* List element for pid hash table. */
 
-  bool load_success; /* Whether the process was loaded successfully. */
+  bool load_success; /* Whether the process was loaded successfully.
+                        Set by the parent before loading, to whether
+                        it is fine to go ahead. */
 
+  struct semaphore start_sema; /* Up once the parent has set us up. */
   struct semaphore load_sema; /* Semaphore for loading. */
   struct semaphore wait_sema; /* Semaphore for waiting. */
   struct semaphore exit_sema; /* Semaphore for exiting. */
@@ -49,6 +57,7 @@ pid_t process_create (struct thread *t);
 
 int process_allocate_fd (struct file *);
 struct file *process_get_file (int);
+bool process_install_fd (int fd, struct file *);
 void process_free_fd (int fd);
 struct process *process_find (pid_t pid);
 
@@ -0,0 +1,323 @@
+#include "userprog/shm.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/aio.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+
+/* Shared memory segments.
+
+   A segment is a set of user pages that any number of processes
+   may map into their address spaces with shm_attach(), so that
+   they see the same physical memory.  Each process holds a
+   reference to a segment for each time it attached it, and the
+   creating process holds one more from shm_create() until it
+   first attaches the segment itself, or exits.  The segment's
+   pages are freed with the last reference.
+
+   Attached pages are mapped in the page directory like any other
+   user page, so they must be unmapped before the page directory
+   is destroyed, which would free them.  shm_exit() takes care of
+   that. */
+
+/* A shared memory segment. */
+struct shm_segment
+  {
+    struct list_elem elem;      /* Element in segments. */
+    int id;                     /* Identifier. */
+    unsigned ref_cnt;           /* Number of references. */
+    size_t page_cnt;            /* Number of pages. */
+    void *pages[];              /* Kernel virtual addresses of pages. */
+  };
+
+/* A process's reference to a segment. */
+struct shm_ref
+  {
+    struct list_elem elem;      /* Element in struct process's shm_refs,
+                                   which is sorted by ADDR. */
+    struct shm_segment *seg;    /* Segment. */
+    void *addr;                 /* User address, or null if the creator's
+                                   reference from shm_create(). */
+  };
+
+/* All segments, and the next identifier to hand out. */
+static struct list segments;
+static int next_id;
+
+/* Protects segments, next_id, and the segments' reference counts. */
+static struct lock shm_lock;
+
+/* Initializes the shared memory system. */
+void
+shm_init (void)
+{
+  list_init (&segments);
+  next_id = 0;
+  lock_init (&shm_lock);
+}
+
+/* Returns the segment with identifier ID, or a null pointer if
+   there is none.  The caller must hold shm_lock. */
+static struct shm_segment *
+lookup_segment (int id)
+{
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&shm_lock));
+  for (e = list_begin (&segments); e != list_end (&segments);
+       e = list_next (e))
+    {
+      struct shm_segment *seg = list_entry (e, struct shm_segment, elem);
+      if (seg->id == id)
+        return seg;
+    }
+  return NULL;
+}
+
+/* Frees SEG's first PAGE_CNT pages and SEG itself. */
+static void
+free_segment (struct shm_segment *seg, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    palloc_free_page (seg->pages[i]);
+  free (seg);
+}
+
+/* Drops a reference to SEG, freeing it if it was the last. */
+static void
+put_segment (struct shm_segment *seg)
+{
+  bool last;
+
+  lock_acquire (&shm_lock);
+  last = --seg->ref_cnt == 0;
+  if (last)
+    list_remove (&seg->elem);
+  lock_release (&shm_lock);
+
+  if (last)
+    free_segment (seg, seg->page_cnt);
+}
+
+/* Returns true if shm_ref A_ is attached below shm_ref B_.
+   References without an address sort first. */
+static bool
+ref_less (const struct list_elem *a_, const struct list_elem *b_,
+          void *aux UNUSED)
+{
+  const struct shm_ref *a = list_entry (a_, struct shm_ref, elem);
+  const struct shm_ref *b = list_entry (b_, struct shm_ref, elem);
+
+  return (uintptr_t) a->addr < (uintptr_t) b->addr;
+}
+
+/* Creates a zeroed segment of SIZE bytes, rounded up to whole
+   pages, for the running process.  Returns its identifier, which
+   other processes may pass to shm_attach(), or -1 if SIZE is 0 or
+   too large, or memory is short. */
+int
+shm_create (size_t size)
+{
+  struct process *p = process_current ();
+  size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  struct shm_segment *seg;
+  struct shm_ref *ref;
+  size_t i;
+
+  if (page_cnt == 0 || page_cnt > SHM_MAX_PAGES)
+    return -1;
+
+  seg = malloc (sizeof *seg + page_cnt * sizeof *seg->pages);
+  ref = malloc (sizeof *ref);
+  if (seg == NULL || ref == NULL)
+    {
+      free (seg);
+      free (ref);
+      return -1;
+    }
+  for (i = 0; i < page_cnt; i++)
+    {
+      seg->pages[i] = palloc_get_page (PAL_USER | PAL_ZERO);
+      if (seg->pages[i] == NULL)
+        {
+          free_segment (seg, i);
+          free (ref);
+          return -1;
+        }
+    }
+  seg->ref_cnt = 1;
+  seg->page_cnt = page_cnt;
+
+  lock_acquire (&shm_lock);
+  seg->id = next_id++;
+  list_push_back (&segments, &seg->elem);
+  lock_release (&shm_lock);
+
+  ref->seg = seg;
+  ref->addr = NULL;
+  list_insert_ordered (&p->shm_refs, &ref->elem, ref_less, NULL);
+  return seg->id;
+}
+
+/* Returns the lowest address in the shared memory area at which
+   PAGE_CNT pages fit between the segments attached in REFS, a
+   process's shm_refs, or a null pointer if there is none. */
+static void *
+find_free_range (struct list *refs, size_t page_cnt)
+{
+  uint8_t *start = SHM_BASE;
+  size_t size = page_cnt * PGSIZE;
+  struct list_elem *e;
+
+  for (e = list_begin (refs); e != list_end (refs); e = list_next (e))
+    {
+      struct shm_ref *r = list_entry (e, struct shm_ref, elem);
+      if (r->addr == NULL)
+        continue;
+      if ((size_t) ((uint8_t *) r->addr - start) >= size)
+        return start;
+      start = (uint8_t *) r->addr + r->seg->page_cnt * PGSIZE;
+    }
+  return (size_t) ((uint8_t *) SHM_TOP - start) >= size ? start : NULL;
+}
+
+/* Unmaps the PAGE_CNT pages at user address ADDR from page
+   directory PD, without freeing them. */
+static void
+unmap_range (uint32_t *pd, uint8_t *addr, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    pagedir_clear_page (pd, addr + i * PGSIZE);
+}
+
+/* Maps the segment with identifier ID into the running process
+   and returns its user address, or a null pointer if there is no
+   such segment or no room for it. */
+void *
+shm_attach (int id)
+{
+  struct process *p = process_current ();
+  uint32_t *pd = thread_current ()->pagedir;
+  struct shm_segment *seg;
+  struct shm_ref *ref;
+  struct list_elem *e;
+  uint8_t *addr;
+  size_t i;
+
+  ref = malloc (sizeof *ref);
+  if (ref == NULL)
+    return NULL;
+
+  lock_acquire (&shm_lock);
+  seg = lookup_segment (id);
+  if (seg != NULL)
+    seg->ref_cnt++;
+  lock_release (&shm_lock);
+  if (seg == NULL)
+    {
+      free (ref);
+      return NULL;
+    }
+
+  addr = find_free_range (&p->shm_refs, seg->page_cnt);
+  if (addr == NULL)
+    goto fail;
+  for (i = 0; i < seg->page_cnt; i++)
+    if (pagedir_get_page (pd, addr + i * PGSIZE) != NULL
+        || !pagedir_set_page (pd, addr + i * PGSIZE, seg->pages[i], true))
+      {
+        /* The executable was loaded over the area, or memory for
+           a page table is short. */
+        unmap_range (pd, addr, i);
+        goto fail;
+      }
+
+  ref->seg = seg;
+  ref->addr = addr;
+  list_insert_ordered (&p->shm_refs, &ref->elem, ref_less, NULL);
+
+  /* The creator's reference from shm_create() has done its job. */
+  for (e = list_begin (&p->shm_refs); e != list_end (&p->shm_refs);
+       e = list_next (e))
+    {
+      struct shm_ref *r = list_entry (e, struct shm_ref, elem);
+      if (r->seg == seg && r->addr == NULL)
+        {
+          list_remove (&r->elem);
+          free (r);
+          put_segment (seg);
+          break;
+        }
+    }
+  return addr;
+
+ fail:
+  free (ref);
+  put_segment (seg);
+  return NULL;
+}
+
+/* Drops REF, held by the process with page directory PD,
+   unmapping the segment if it is attached. */
+static void
+release_ref (uint32_t *pd, struct shm_ref *ref)
+{
+  if (ref->addr != NULL && pd != NULL)
+    unmap_range (pd, ref->addr, ref->seg->page_cnt);
+  list_remove (&ref->elem);
+  put_segment (ref->seg);
+  free (ref);
+}
+
+/* Unmaps the segment attached at ADDR in the running process.
+   Returns true if successful, false if no segment is attached
+   there or asynchronous I/O requests still in flight use it.
+   Unmapping it then could free its pages under the workers. */
+bool
+shm_detach (void *addr)
+{
+  struct process *p = process_current ();
+  struct list_elem *e;
+
+  if (addr == NULL)
+    return false;
+  for (e = list_begin (&p->shm_refs); e != list_end (&p->shm_refs);
+       e = list_next (e))
+    {
+      struct shm_ref *ref = list_entry (e, struct shm_ref, elem);
+      if (ref->addr == addr)
+        {
+          if (aio_busy (addr, ref->seg->page_cnt * PGSIZE))
+            return false;
+          release_ref (thread_current ()->pagedir, ref);
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Drops all of the running process's references to segments,
+   unmapping them from its page directory.  Must be called before
+   that page directory is destroyed. */
+void
+shm_exit (void)
+{
+  struct process *p = process_current ();
+
+  while (!list_empty (&p->shm_refs))
+    {
+      struct shm_ref *ref = list_entry (list_front (&p->shm_refs),
+                                        struct shm_ref, elem);
+      release_ref (thread_current ()->pagedir, ref);
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef USERPROG_SHM_H
+#define USERPROG_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* User virtual address range that shared memory segments are
+   attached in, between the executable's data and the stack. */
+#define SHM_BASE ((void *) 0x40000000)
+#define SHM_TOP ((void *) 0x80000000)
+
+/* Largest segment, in pages. */
+#define SHM_MAX_PAGES 1024
+
+void shm_init (void);
+int shm_create (size_t size);
+void *shm_attach (int id);
+bool shm_detach (void *addr);
+void shm_exit (void);
+
+#endif /* userprog/shm.h */
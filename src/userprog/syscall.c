@@ -8,51 +8,126 @@
 #include "filesys/inode.h"
 #include "kernel/debug.h"
 #include "pagedir.h"
+#include "threads/cpu.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/aio.h"
 #include "userprog/process.h"
+#include "userprog/shm.h"
+#include "userprog/uaccess.h"
 #include "utils/colors.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include <uio.h>
 
 static struct lock filesys_lock; /* Lock for file system operations */
 
+/* Maximum number of arguments to a system call. */
+#define SYSCALL_MAX_ARGS 4
+
+/* How the dispatcher treats a system call argument before
+   passing it on to the handler. */
+enum syscall_arg_type
+  {
+    ARG_INT,                    /* Passed through as is. */
+    ARG_STR,                    /* String, copied into a kernel page. */
+    ARG_BUF_IN,                 /* Buffer the kernel reads from,
+                                   whose size is the next argument. */
+    ARG_BUF_OUT                 /* Buffer the kernel writes into,
+                                   whose size is the next argument. */
+  };
+
+/* A system call handler.  ARGS holds the call's arguments, after
+   processing according to their types.  The return value is
+   passed back to the user in EAX. */
+typedef uint32_t syscall_func (uint32_t args[]);
+
+/* Number of buckets in a latency histogram.  Bucket I counts
+   calls that took between 2**I and 2**(I+1) - 1 cycles. */
+#define LATENCY_BUCKETS 32
+
+/* A system call. */
+struct syscall
+  {
+    const char *name;                   /* Name, for tracing. */
+    syscall_func *func;                 /* Handler. */
+    int argc;                           /* Number of arguments. */
+    enum syscall_arg_type types[SYSCALL_MAX_ARGS]; /* Argument types. */
+
+    /* Statistics, updated with interrupts off. */
+    unsigned long long calls;           /* Number of calls. */
+    unsigned long long cycles;          /* Cycles spent in returning calls. */
+    unsigned latency[LATENCY_BUCKETS];  /* Histogram of cycles per call. */
+  };
+
+/* Number of system calls made by each entry path. */
+static unsigned long long int_cnt;      /* Through "int $0x30". */
+static unsigned long long sysenter_cnt; /* Through SYSENTER. */
+
 static void syscall_handler (struct intr_frame *);
-static void halt (void) NO_RETURN;
 static void exit (int status) NO_RETURN;
-static pid_t exec (const char *file);
-static int wait (pid_t);
-static bool create (const char *file, unsigned initial_size);
-static bool remove (const char *file);
-static int open (const char *file);
-static int filesize (int fd);
-static int read (int fd, void *buffer, unsigned size);
-static int write (int fd, const void *buffer, unsigned size);
-static void seek (int fd, unsigned position);
-static unsigned tell (int fd);
-static void close (int fd);
-static bool chdir (const char *dir);
-static bool mkdir (const char *dir);
-static bool readdir (int fd, char *name);
-static bool isdir (int fd);
-static int inumber (int fd);
-
-#ifdef DEBUG_KERNEL
-#define DEBUG_PRINT_SYSCALL_START(...)                                        \
-  printf (COLOR_HBLK);                                                        \
-  printf (__VA_ARGS__);                                                       \
-  printf (COLOR_RESET);
-#define DEBUG_PRINT_SYSCALL_END(...)                                          \
-  printf (COLOR_CYN);                                                         \
-  printf (__VA_ARGS__);                                                       \
-  printf (COLOR_RESET "\n");
-#else
-#define DEBUG_PRINT_SYSCALL_START(...)
-#define DEBUG_PRINT_SYSCALL_END(...)
-#endif
+void syscall_sysenter (struct intr_frame *);
+
+static syscall_func sys_halt, sys_exit, sys_exec, sys_wait, sys_create,
+  sys_remove, sys_open, sys_filesize, sys_read, sys_write, sys_seek,
+  sys_tell, sys_close, sys_chdir, sys_mkdir, sys_readdir, sys_isdir,
+  sys_inumber, sys_pipe, sys_dup2, sys_shm_create, sys_shm_attach,
+  sys_shm_detach, sys_aio_setup, sys_aio_enter, sys_pread, sys_pwrite,
+  sys_readv, sys_writev, sys_copy_file_range, sys_fsync, sys_fdatasync,
+  sys_fadvise;
+
+/* System calls, indexed by number.  Calls without a handler,
+   such as those of the VM project, kill the process. */
+static struct syscall syscalls[] =
+  {
+    [SYS_HALT] = {"halt", sys_halt, 0, {}},
+    [SYS_EXIT] = {"exit", sys_exit, 1, {ARG_INT}},
+    [SYS_EXEC] = {"exec", sys_exec, 1, {ARG_STR}},
+    [SYS_WAIT] = {"wait", sys_wait, 1, {ARG_INT}},
+    [SYS_CREATE] = {"create", sys_create, 2, {ARG_STR, ARG_INT}},
+    [SYS_REMOVE] = {"remove", sys_remove, 1, {ARG_STR}},
+    [SYS_OPEN] = {"open", sys_open, 1, {ARG_STR}},
+    [SYS_FILESIZE] = {"filesize", sys_filesize, 1, {ARG_INT}},
+    [SYS_READ] = {"read", sys_read, 3, {ARG_INT, ARG_BUF_OUT, ARG_INT}},
+    [SYS_WRITE] = {"write", sys_write, 3, {ARG_INT, ARG_BUF_IN, ARG_INT}},
+    [SYS_SEEK] = {"seek", sys_seek, 2, {ARG_INT, ARG_INT}},
+    [SYS_TELL] = {"tell", sys_tell, 1, {ARG_INT}},
+    [SYS_CLOSE] = {"close", sys_close, 1, {ARG_INT}},
+    [SYS_MMAP] = {"mmap", NULL, 2, {ARG_INT, ARG_INT}},
+    [SYS_MUNMAP] = {"munmap", NULL, 1, {ARG_INT}},
+    [SYS_CHDIR] = {"chdir", sys_chdir, 1, {ARG_STR}},
+    [SYS_MKDIR] = {"mkdir", sys_mkdir, 1, {ARG_STR}},
+    [SYS_READDIR] = {"readdir", sys_readdir, 2, {ARG_INT, ARG_INT}},
+    [SYS_ISDIR] = {"isdir", sys_isdir, 1, {ARG_INT}},
+    [SYS_INUMBER] = {"inumber", sys_inumber, 1, {ARG_INT}},
+    [SYS_PIPE] = {"pipe", sys_pipe, 1, {ARG_INT}},
+    [SYS_DUP2] = {"dup2", sys_dup2, 2, {ARG_INT, ARG_INT}},
+    [SYS_SHM_CREATE] = {"shm_create", sys_shm_create, 1, {ARG_INT}},
+    [SYS_SHM_ATTACH] = {"shm_attach", sys_shm_attach, 1, {ARG_INT}},
+    [SYS_SHM_DETACH] = {"shm_detach", sys_shm_detach, 1, {ARG_INT}},
+    [SYS_AIO_SETUP] = {"aio_setup", sys_aio_setup, 0, {}},
+    [SYS_AIO_ENTER] = {"aio_enter", sys_aio_enter, 2, {ARG_INT, ARG_INT}},
+    [SYS_PREAD] = {"pread", sys_pread, 4,
+                   {ARG_INT, ARG_BUF_OUT, ARG_INT, ARG_INT}},
+    [SYS_PWRITE] = {"pwrite", sys_pwrite, 4,
+                    {ARG_INT, ARG_BUF_IN, ARG_INT, ARG_INT}},
+    [SYS_READV] = {"readv", sys_readv, 3, {ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_WRITEV] = {"writev", sys_writev, 3, {ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_COPY_FILE_RANGE] = {"copy_file_range", sys_copy_file_range, 3,
+                             {ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_FSYNC] = {"fsync", sys_fsync, 1, {ARG_INT}},
+    [SYS_FDATASYNC] = {"fdatasync", sys_fdatasync, 1, {ARG_INT}},
+    [SYS_FADVISE] = {"fadvise", sys_fadvise, 4,
+                     {ARG_INT, ARG_INT, ARG_INT, ARG_INT}},
+  };
+
+/* Number of entries in syscalls[]. */
+#define SYSCALL_CNT (sizeof syscalls / sizeof *syscalls)
 
 /* Registers handlers for system call. Also init filesys_lock here. */
 void
@@ -60,421 +135,233 @@ syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
   lock_init (&filesys_lock);
+  shm_init ();
+  aio_init ();
 }
 
-/* Reads a byte at user virtual address UADDR.
-   UADDR must be below PHYS_BASE.
-   Returns the byte value if successful, -1 if a segfault
-   occurred. */
-static int
-get_user (const uint8_t *uaddr)
+/* Copies SIZE bytes from user address USRC to DST.
+   Exits if the user range is invalid. */
+static void
+copy_in (void *dst, const void *usrc, size_t size)
 {
-  int result;
-  asm("movl $1f, %0; movzbl %1, %0; 1:" : "=&a"(result) : "m"(*uaddr));
-  return result;
-}
+  if (copy_from_user (dst, usrc, size))
+    return;
 
-/* Writes BYTE to user address UDST.
-   UDST must be below PHYS_BASE.
-   Returns true if successful, false if a segfault occurred. */
-static bool
-put_user (uint8_t *udst, uint8_t byte)
-{
-  int error_code;
-  asm("movl $1f, %0; movb %b2, %1; 1:"
-      : "=&a"(error_code), "=m"(*udst)
-      : "q"(byte));
-  return error_code != -1;
+  DEBUG_PRINT (COLOR_HRED "Invalid address: %p", usrc);
+  exit (-1);
 }
 
-/* Check if the address is invalid. */
-static bool
-is_invalid_address (const void *address)
+/* Exits unless the SIZE bytes of user memory at BUFFER are
+   mapped, and writable as well if WRITE is true. */
+static void
+check_buffer (const void *buffer, size_t size, bool write)
 {
-  bool valid = address != NULL && is_user_vaddr (address);
-  if (valid && get_user ((const uint8_t *)address) == -1)
-    valid = false;
+  if (probe_user (buffer, size, write))
+    return;
 
-  return !valid;
+  DEBUG_PRINT (COLOR_HRED "Invalid buffer: %p", buffer);
+  exit (-1);
 }
 
-/* Exit if the address is invalid. */
+/* Frees the kernel copies of the string arguments among the
+   first ARGC arguments in ARGS to system call SC. */
 static void
-check_address (const void *address)
+free_args (const struct syscall *sc, uint32_t args[], int argc)
 {
-  if (!is_invalid_address (address))
-    return;
+  int i;
 
-  DEBUG_PRINT (COLOR_HRED "Invalid address: %p", address);
-  exit (-1);
+  for (i = 0; i < argc; i++)
+    if (sc->types[i] == ARG_STR)
+      palloc_free_page ((void *) args[i]);
 }
 
-/* Exit if the string is invalid. */
+/* Checks and copies in the arguments of system call SC, which
+   the user passed in ARGS.  String arguments are replaced by
+   kernel copies, which free_args() frees.  Exits if any argument
+   is invalid. */
 static void
-check_string (const char *string)
+prepare_args (const struct syscall *sc, uint32_t args[])
 {
-  check_address (string);
-  while (*string != '\0')
-    check_address (++string);
+  int i;
+
+  for (i = 0; i < sc->argc; i++)
+    switch (sc->types[i])
+      {
+      case ARG_INT:
+        break;
+
+      case ARG_STR:
+        {
+          char *kstr = palloc_get_page (0);
+          int len = -1;
+
+          if (kstr != NULL)
+            len = strncpy_from_user (kstr, (const char *) args[i], PGSIZE);
+          if (len < 0 || len >= PGSIZE)
+            {
+              /* exit() does not return, so free the strings
+                 copied so far first. */
+              palloc_free_page (kstr);
+              free_args (sc, args, i);
+              DEBUG_PRINT (COLOR_HRED "Invalid string: %p",
+                           (void *) args[i]);
+              exit (-1);
+            }
+          args[i] = (uint32_t) kstr;
+        }
+        break;
+
+      case ARG_BUF_IN:
+      case ARG_BUF_OUT:
+        ASSERT (i + 1 < sc->argc);
+        check_buffer ((void *) args[i], args[i + 1],
+                      sc->types[i] == ARG_BUF_OUT);
+        break;
+      }
 }
 
-/* Name of system call. */
-static const char *
-syscall_name (int syscall_number)
+#ifdef DEBUG_KERNEL
+/* Prints system call SC with its arguments ARGS. */
+static void
+trace_syscall (const struct syscall *sc, const uint32_t args[])
 {
-  switch (syscall_number)
+  int i;
+
+  printf (COLOR_HBLK "(%s (", sc->name);
+  for (i = 0; i < sc->argc; i++)
     {
-    case SYS_HALT:
-      return "halt";
-    case SYS_EXIT:
-      return "exit";
-    case SYS_EXEC:
-      return "exec";
-    case SYS_WAIT:
-      return "wait";
-    case SYS_CREATE:
-      return "create";
-    case SYS_REMOVE:
-      return "remove";
-    case SYS_OPEN:
-      return "open";
-    case SYS_FILESIZE:
-      return "filesize";
-    case SYS_READ:
-      return "read";
-    case SYS_WRITE:
-      return "write";
-    case SYS_SEEK:
-      return "seek";
-    case SYS_TELL:
-      return "tell";
-    case SYS_CLOSE:
-      return "close";
-    case SYS_MMAP:
-      return "mmap";
-    case SYS_MUNMAP:
-      return "munmap";
-    case SYS_CHDIR:
-      return "chdir";
-    case SYS_MKDIR:
-      return "mkdir";
-    case SYS_READDIR:
-      return "readdir";
-    case SYS_ISDIR:
-      return "isdir";
-    case SYS_INUMBER:
-      return "inumber";
-    default:
-      return "unknown";
+      if (i > 0)
+        printf (", ");
+      if (sc->types[i] == ARG_STR)
+        printf ("\"%s\"", (const char *) args[i]);
+      else if (sc->types[i] == ARG_INT)
+        printf ("%d", (int) args[i]);
+      else
+        printf ("%p", (void *) args[i]);
     }
+  printf ("))" COLOR_RESET);
 }
+#endif
 
-/* Number of arguments of system call. */
-static size_t
-syscall_argc (int syscall_number)
+/* Records that a call to SC took CYCLES cycles. */
+static void
+account_syscall (struct syscall *sc, uint64_t cycles)
 {
-  switch (syscall_number)
-    {
-    case SYS_HALT:
-      return 0;
-    case SYS_EXIT:
-      return 1;
-    case SYS_EXEC:
-      return 1;
-    case SYS_WAIT:
-      return 1;
-    case SYS_CREATE:
-      return 2;
-    case SYS_REMOVE:
-      return 1;
-    case SYS_OPEN:
-      return 1;
-    case SYS_FILESIZE:
-      return 1;
-    case SYS_READ:
-      return 3;
-    case SYS_WRITE:
-      return 3;
-    case SYS_SEEK:
-      return 2;
-    case SYS_TELL:
-      return 1;
-    case SYS_CLOSE:
-      return 1;
-    case SYS_MMAP:
-      return 2;
-    case SYS_MUNMAP:
-      return 1;
-    case SYS_CHDIR:
-      return 1;
-    case SYS_MKDIR:
-      return 1;
-    case SYS_READDIR:
-      return 2;
-    case SYS_ISDIR:
-      return 1;
-    case SYS_INUMBER:
-      return 1;
-    default:
-      return 0;
-    }
+  enum intr_level old_level;
+  int bucket = 0;
+
+  while (bucket < LATENCY_BUCKETS - 1 && (cycles >> (bucket + 1)) != 0)
+    bucket++;
+
+  old_level = intr_disable ();
+  sc->cycles += cycles;
+  sc->latency[bucket]++;
+  intr_set_level (old_level);
 }
 
-/* Size of arguments of system call. */
-static size_t
-syscall_arg_size (int syscall_number)
+/* Handles a system call: looks up the call's descriptor by
+   number, copies in and checks its arguments, and invokes its
+   handler.  Counts the call in *PATH_CNT. */
+static void
+dispatch (struct intr_frame *f, unsigned long long *path_cnt)
 {
-  switch (syscall_number)
+  const int *sp = f->esp;
+  uint32_t args[SYSCALL_MAX_ARGS];
+  struct syscall *sc;
+  enum intr_level old_level;
+  uint64_t start;
+  int nr;
+
+  copy_in (&nr, sp, sizeof nr);
+  if (nr < 0 || (size_t) nr >= SYSCALL_CNT || syscalls[nr].func == NULL)
     {
-    case SYS_HALT:
-      return 0;
-    case SYS_EXIT:
-      return sizeof (int);
-    case SYS_EXEC:
-      return sizeof (const char *);
-    case SYS_WAIT:
-      return sizeof (int);
-    case SYS_CREATE:
-      return sizeof (const char *) + sizeof (unsigned);
-    case SYS_REMOVE:
-      return sizeof (const char *);
-    case SYS_OPEN:
-      return sizeof (const char *);
-    case SYS_FILESIZE:
-      return sizeof (int);
-    case SYS_READ:
-      return sizeof (int) + sizeof (void *) + sizeof (unsigned);
-    case SYS_WRITE:
-      return sizeof (int) + sizeof (const void *) + sizeof (unsigned);
-    case SYS_SEEK:
-      return sizeof (int) + sizeof (unsigned);
-    case SYS_TELL:
-      return sizeof (int);
-    case SYS_CLOSE:
-      return sizeof (int);
-    case SYS_MMAP:
-      return sizeof (int) + sizeof (void *);
-    case SYS_MUNMAP:
-      return sizeof (int);
-    case SYS_CHDIR:
-      return sizeof (const char *);
-    case SYS_MKDIR:
-      return sizeof (const char *);
-    case SYS_READDIR:
-      return sizeof (int) + sizeof (void *);
-    case SYS_ISDIR:
-      return sizeof (int);
-    case SYS_INUMBER:
-      return sizeof (int);
-    default:
-      return 0;
+      DEBUG_PRINT (COLOR_HRED "Unknown system call %d", nr);
+      exit (-1);
     }
-}
+  sc = &syscalls[nr];
 
-/* Exit if the system call sp or the argument is invalid. */
-static void
-check_sp_and_arg (int *sp)
-{
-  void *arg = (void *)sp;
+  old_level = intr_disable ();
+  (*path_cnt)++;
+  sc->calls++;
+  intr_set_level (old_level);
 
-  for (size_t i = 0; i < sizeof (sp); i++)
-    check_address (++arg);
+  start = rdtsc ();
+  copy_in (args, sp + 1, sc->argc * sizeof *args);
+  prepare_args (sc, args);
 
-  size_t arg_size = syscall_arg_size (get_user ((const uint8_t *)sp));
+#ifdef DEBUG_KERNEL
+  if (nr != SYS_WRITE || args[0] >= 2)
+    trace_syscall (sc, args);
+#endif
 
-  for (size_t i = 0; i < arg_size; i++)
-    check_address (++arg);
+  f->eax = sc->func (args);
+  free_args (sc, args, sc->argc);
+
+#ifdef DEBUG_KERNEL
+  if (nr != SYS_WRITE || args[0] >= 2)
+    printf (COLOR_CYN " -> %d" COLOR_RESET "\n", (int) f->eax);
+#endif
+
+  account_syscall (sc, rdtsc () - start);
 }
 
-/* Handle syscals and also check if inputs are correct */
+/* Handles a system call made with "int $0x30". */
 static void
 syscall_handler (struct intr_frame *f)
 {
-  int *sp = f->esp;
-  uint32_t ret = 0;
+  dispatch (f, &int_cnt);
+}
 
-  check_sp_and_arg (sp);
-  const char *syscall = syscall_name (*sp);
+/* Handles a system call made with SYSENTER.  Called by
+   sysenter_entry() in sysenter.S with interrupts off, which must
+   also be off on return. */
+void
+syscall_sysenter (struct intr_frame *f)
+{
+  intr_enable ();
+  dispatch (f, &sysenter_cnt);
+  intr_disable ();
+}
 
-  switch (*sp)
+/* Prints the number of calls to each system call that has been
+   used, their average cost in CPU cycles, and a histogram of
+   their cost, as "2^N:COUNT" pairs. */
+void
+syscall_print_stats (void)
+{
+  size_t i;
+
+  printf ("Syscall: %llu through int $0x30, %llu through sysenter\n",
+          int_cnt, sysenter_cnt);
+  for (i = 0; i < SYSCALL_CNT; i++)
     {
-    case SYS_HALT:
-      {
-        DEBUG_PRINT_SYSCALL_START ("(%s)", syscall);
-        halt ();
-        DEBUG_PRINT_SYSCALL_END ("[%s]", syscall);
-        break;
-      }
-    case SYS_EXIT:
-      {
-        int status = *(sp + 1);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%d))", syscall, status);
-        exit (status);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%d)]", syscall, status);
-        break;
-      }
-    case SYS_EXEC:
-      {
-        char *cmd_line = (char *)*(sp + 1);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%s))", syscall, cmd_line);
-        ret = exec (cmd_line);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%s) -> %d]", syscall, cmd_line, ret);
-        break;
-      }
-    case SYS_WAIT:
-      {
-        pid_t pid = *(sp + 1);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%d))", syscall, pid);
-        ret = wait (pid);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%d) -> %d]", syscall, pid, ret);
-        break;
-      }
-    case SYS_CREATE:
-      {
-        char *file = (char *)*(sp + 1);
-        unsigned initial_size = *(sp + 2);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%s, %d))", syscall, file,
-                                   initial_size);
-        ret = create (file, initial_size);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%s, %d) -> %d]", syscall, file,
-                                 initial_size, ret);
-        break;
-      }
-    case SYS_REMOVE:
-      {
-        char *file = (char *)*(sp + 1);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%s))", syscall, file);
-        ret = remove (file);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%s) -> %d]", syscall, file, ret);
-        break;
-      }
-    case SYS_OPEN:
-      {
-        char *file = (char *)*(sp + 1);
-        ret = open (file);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%s) -> %d]", syscall, file, ret);
-        break;
-      }
-    case SYS_FILESIZE:
-      {
-        int fd = *(sp + 1);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%d))", syscall, fd);
-        ret = filesize (fd);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%d) -> %d]", syscall, fd, ret);
-        break;
-      }
-    case SYS_READ:
-      {
-        int fd = *(sp + 1);
-        void *buffer = (void *)*(sp + 2);
-        unsigned size = *(sp + 3);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%d, %p, %d))", syscall, fd, buffer,
-                                   size);
-        ret = read (fd, buffer, size);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%d, %p, %d) -> %d]", syscall, fd,
-                                 buffer, size, ret);
-        break;
-      }
-    case SYS_WRITE:
-      {
-        int fd = *(sp + 1);
-        const void *buffer = (const void *)*(sp + 2);
-        unsigned size = *(sp + 3);
-        if (fd >= 2)
-          {
-            DEBUG_PRINT_SYSCALL_START ("(%s (%d, %p, %d))", syscall, fd,
-                                       buffer, size);
-          }
-        ret = write (fd, buffer, size);
-        if (fd >= 2)
-          {
-            DEBUG_PRINT_SYSCALL_END ("[%s (%d, %p, %d) -> %d]", syscall, fd,
-                                     buffer, size, ret);
-          }
-        break;
-      }
-    case SYS_SEEK:
-      {
-        int fd = *(sp + 1);
-        unsigned position = *(sp + 2);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%d, %d))", syscall, fd, position);
-        seek (fd, position);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%d, %d)]", syscall, fd, position);
-        break;
-      }
-    case SYS_TELL:
-      {
-        int fd = *(sp + 1);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%d))", syscall, fd);
-        ret = tell (fd);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%d) -> %d]", syscall, fd, ret);
-        break;
-      }
-    case SYS_CLOSE:
-      {
-        int fd = *(sp + 1);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%d))", syscall, fd);
-        close (fd);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%d)]", syscall, fd);
-        break;
-      }
-    case SYS_CHDIR:
-      {
-        char *dir = (char *)*(sp + 1);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%s))", syscall, dir);
-        ret = chdir (dir);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%s) -> %d]", syscall, dir, ret);
-        break;
-      }
-    case SYS_MKDIR:
-      {
-        char *dir = (char *)*(sp + 1);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%s))", syscall, dir);
-        ret = mkdir (dir);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%s) -> %d]", syscall, dir, ret);
-        break;
-      }
-    case SYS_READDIR:
-      {
-        int fd = *(sp + 1);
-        char *name = (char *)*(sp + 2);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%d, %p))", syscall, fd, name);
-        ret = readdir (fd, name);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%d, %p) -> %d]", syscall, fd, name,
-                                 ret);
-        break;
-      }
-    case SYS_ISDIR:
-      {
-        int fd = *(sp + 1);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%d))", syscall, fd);
-        ret = isdir (fd);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%d) -> %d]", syscall, fd, ret);
-        break;
-      }
-    case SYS_INUMBER:
-      {
-        int fd = *(sp + 1);
-        DEBUG_PRINT_SYSCALL_START ("(%s (%d))", syscall, fd);
-        ret = inumber (fd);
-        DEBUG_PRINT_SYSCALL_END ("[%s (%d) -> %d]", syscall, fd, ret);
-        break;
-      }
-    default:
-      PANIC (COLOR_RED "Unknown system call %s" COLOR_RESET, syscall);
-      ret = -1;
-      break;
-    }
+      const struct syscall *sc = &syscalls[i];
+      unsigned long long returned = 0;
+      int b;
+
+      if (sc->calls == 0)
+        continue;
 
-  f->eax = ret;
-  // thread_exit ();
+      for (b = 0; b < LATENCY_BUCKETS; b++)
+        returned += sc->latency[b];
+
+      printf ("Syscall: %s: %llu calls", sc->name, sc->calls);
+      if (returned > 0)
+        {
+          printf (", %llu cycles avg,", sc->cycles / returned);
+          for (b = 0; b < LATENCY_BUCKETS; b++)
+            if (sc->latency[b] != 0)
+              printf (" 2^%d:%u", b, sc->latency[b]);
+        }
+      printf ("\n");
+    }
 }
 
 /* Terminates Pintos by calling shutdown_power_off() (declared in
    "threads/init.h"). This should be seldom used, because you lose
    the ability to shut down the system. */
-static void
-halt (void)
+static uint32_t
+sys_halt (uint32_t args[] UNUSED)
 {
   shutdown_power_off ();
 }
@@ -484,12 +371,10 @@ halt (void)
 static int
 read_stdin (void *buffer, unsigned size)
 {
-  char *buf = buffer;
+  uint8_t *buf = buffer;
   for (unsigned i = 0; i < size; i++)
-    {
-      check_address (buf);
-      buf[i] = input_getc ();
-    }
+    if (!put_user (buf + i, input_getc ()))
+      exit (-1);
   return size;
 }
 
@@ -498,13 +383,13 @@ static int
 write_stdout (const void *buffer, unsigned size)
 {
   const char *buf = buffer;
-  for (; size >= WRITE_BUF_SIZE; size -= WRITE_BUF_SIZE)
+  unsigned left;
+  for (left = size; left >= WRITE_BUF_SIZE; left -= WRITE_BUF_SIZE)
     {
-      check_address (buf);
       putbuf (buf, WRITE_BUF_SIZE);
       buf += WRITE_BUF_SIZE;
     }
-  putbuf (buf, size);
+  putbuf (buf, left);
 
   return size;
 }
@@ -524,13 +409,20 @@ exit (int status)
   thread_exit ();
 }
 
+/* exit (STATUS). */
+static uint32_t
+sys_exit (uint32_t args[])
+{
+  exit (args[0]);
+}
+
 /* Runs the executable whose name is given in CMD_LINE, passing any
    given arguments, and returns the new process's program id (pid).
    If the program cannot load or run for any reason, returns -1. */
-static pid_t
-exec (const char *cmd_line)
+static uint32_t
+sys_exec (uint32_t args[])
 {
-  check_string (cmd_line);
+  const char *cmd_line = (const char *) args[0];
 
   tid_t tid = process_execute (cmd_line);
   if (tid == TID_ERROR)
@@ -560,9 +452,11 @@ exec (const char *cmd_line)
    returns the status that pid passed to exit. If pid did not call
    exit(), but was terminated by the kernel (e.g. killed due to an
    exception), wait(pid) returns -1. */
-static int
-wait (pid_t pid)
+static uint32_t
+sys_wait (uint32_t args[])
 {
+  pid_t pid = args[0];
+
   if (pid == PID_ERROR)
     return -1;
 
@@ -572,10 +466,11 @@ wait (pid_t pid)
 /* Creates a file called FILE initially INITIAL_SIZE bytes in size.
    Returns true if successful, false otherwise. Creating a file does
    not open it. To open a file, use open(). */
-static bool
-create (const char *file, unsigned initial_size)
+static uint32_t
+sys_create (uint32_t args[])
 {
-  check_string (file);
+  const char *file = (const char *) args[0];
+  unsigned initial_size = args[1];
 
   return filesys_create (file, initial_size);
 }
@@ -584,10 +479,10 @@ create (const char *file, unsigned initial_size)
    successful, false otherwise. A file may be removed regardless of
    whether it is open or closed, and removing an open file does not
    close it. */
-static bool
-remove (const char *file)
+static uint32_t
+sys_remove (uint32_t args[])
 {
-  check_string (file);
+  const char *file = (const char *) args[0];
 
   return filesys_remove (file);
 }
@@ -595,11 +490,10 @@ remove (const char *file)
 /* Opens the file called FILE. Returns a nonnegative integer handle
    called a "file descriptor" (fd), or -1 if the file could not be
    opened. */
-static int
-open (const char *file)
+static uint32_t
+sys_open (uint32_t args[])
 {
-  check_string (file);
-  DEBUG_PRINT_SYSCALL_START ("(%s (%s))", "open", file);
+  const char *file = (const char *) args[0];
 
   struct file *f = filesys_open (file);
   if (f == NULL)
@@ -608,10 +502,12 @@ open (const char *file)
   return fd;
 }
 
-/* Returns the size, in bytes, of the file open as FS. */
-static int
-filesize (int fd)
+/* Returns the size, in bytes, of the file open as FD. */
+static uint32_t
+sys_filesize (uint32_t args[])
 {
+  int fd = args[0];
+
   struct file *f = process_get_file (fd);
   return file_length (f);
 }
@@ -619,94 +515,95 @@ filesize (int fd)
 /* Reads SIZE bytes from the file open as FD into BUFFER. Returns
    the number of bytes actually read (0 at end of file), or -1 if
    the file could not be read (due to a condition other than end
-   of file). */
-static int
-read (int fd, void *buffer, unsigned size)
+   of file).  Standard input reads the keyboard unless a file has
+   been installed there with dup2(). */
+static uint32_t
+sys_read (uint32_t args[])
 {
-  check_address (buffer);
+  int fd = args[0];
+  void *buffer = (void *) args[1];
+  unsigned size = args[2];
 
+  struct file *f = process_get_file (fd);
+  if (f != NULL)
+    return file_read (f, buffer, size);
   if (fd == STDIN_FILENO)
-    {
-      return read_stdin (buffer, size);
-    }
-  else
-    {
-      struct file *f = process_get_file (fd);
-      if (f == NULL)
-        {
-          DEBUG_PRINT_SYSCALL_END (COLOR_HRED "[open %d failed]", fd);
-          thread_exit ();
-        }
-      return file_read (f, buffer, size);
-    }
+    return read_stdin (buffer, size);
+
+  DEBUG_PRINT (COLOR_HRED "[open %d failed]", fd);
+  thread_exit ();
 }
 
 /* Writes SIZE bytes from BUFFER to the open file FD. Returns the
    number of bytes actually written, which may be less than SIZE if
-   some bytes could not be written. */
-static int
-write (int fd, const void *buffer, unsigned size)
+   some bytes could not be written.  Standard output writes to the
+   console unless a file has been installed there with dup2(). */
+static uint32_t
+sys_write (uint32_t args[])
 {
-  int write_size;
-  check_address (buffer);
+  int fd = args[0];
+  const void *buffer = (const void *) args[1];
+  unsigned size = args[2];
 
+  struct file *f = process_get_file (fd);
+  if (f != NULL)
+    return file_write (f, buffer, size);
   if (fd == STDOUT_FILENO)
-    {
-      write_size = write_stdout (buffer, size);
-    }
-  else
-    {
-      struct file *f = process_get_file (fd);
-      if (f == NULL)
-        {
-          DEBUG_PRINT_SYSCALL_END (COLOR_HRED "[open %d failed]", fd);
-          thread_exit ();
-        }
-      write_size = file_write (f, buffer, size);
-    }
-  return write_size;
+    return write_stdout (buffer, size);
+
+  DEBUG_PRINT (COLOR_HRED "[open %d failed]", fd);
+  thread_exit ();
 }
 
 /* Changes the next byte to be read or written in open file FD to
    position POSITION, expressed as a byte offset from the beginning
    of the file. (Thus, a position of 0 is the file's start.) */
-static void
-seek (int fd, unsigned position)
+static uint32_t
+sys_seek (uint32_t args[])
 {
+  int fd = args[0];
+  unsigned position = args[1];
+
   struct file *f = process_get_file (fd);
   file_seek (f, position);
+  return 0;
 }
 
 /* Returns the position of the next byte to be read or written in
    open file FD, expressed in bytes from the beginning of the
    file. */
-static unsigned
-tell (int fd)
+static uint32_t
+sys_tell (uint32_t args[])
 {
+  int fd = args[0];
+
   struct file *f = process_get_file (fd);
   return file_tell (f);
 }
 
 /* Closes file descriptor FD. */
-static void
-close (int fd)
+static uint32_t
+sys_close (uint32_t args[])
 {
+  int fd = args[0];
+
   struct file *f = process_get_file (fd);
   if (f == NULL)
     {
-      DEBUG_PRINT_SYSCALL_END (COLOR_HRED "[close %d failed]", fd);
+      DEBUG_PRINT (COLOR_HRED "[close %d failed]", fd);
       thread_exit ();
     }
   file_close (f);
   process_free_fd (fd);
+  return 0;
 }
 
 /* Changes the current working directory of the process to DIR.
    Returns true if successful, false on failure. */
-static bool
-chdir (const char *dir)
+static uint32_t
+sys_chdir (uint32_t args[])
 {
-  check_string (dir);
+  const char *dir = (const char *) args[0];
 
   return process_chdir (dir);
 }
@@ -717,10 +614,10 @@ chdir (const char *dir)
    Fails if DIR already exists or if any directory name in DIR,
    besides the last, does not already exist. That is, mkdir("/a/b/c")
    succeeds only if /a/b already exists and /a/b/c does not. */
-static bool
-mkdir (const char *dir)
+static uint32_t
+sys_mkdir (uint32_t args[])
 {
-  check_string (dir);
+  const char *dir = (const char *) args[0];
 
   return filesys_create_dir (dir);
 }
@@ -736,39 +633,49 @@ mkdir (const char *dir)
    for some entries not to be read at all or to be read multiple
    times. Otherwise, each directory entry should be read once, in
    any order. */
-static bool
-readdir (int fd, char *name)
+static uint32_t
+sys_readdir (uint32_t args[])
 {
-  check_address (name);
+  int fd = args[0];
+  char *uname = (char *) args[1];
+  char name[NAME_MAX + 1];
+
+  check_buffer (uname, sizeof name, true);
 
   struct file *f = process_get_file (fd);
   if (f == NULL)
     {
-      DEBUG_PRINT_SYSCALL_END (COLOR_HRED "[open %d failed]", fd);
+      DEBUG_PRINT (COLOR_HRED "[open %d failed]", fd);
       thread_exit ();
     }
 
   if (!file_is_dir (f))
     {
-      DEBUG_PRINT_SYSCALL_END (COLOR_HRED "[%d is not a directory]", fd);
+      DEBUG_PRINT (COLOR_HRED "[%d is not a directory]", fd);
       thread_exit ();
     }
 
   // HACK: Although dir_readdir is expecting a dir *, passing a
   // file * should "just work" because the consistency of theses
   // two structures.
-  return dir_readdir ((struct dir *)f, name);
+  if (!dir_readdir ((struct dir *)f, name))
+    return false;
+  if (!copy_to_user (uname, name, strlen (name) + 1))
+    exit (-1);
+  return true;
 }
 
 /* Returns true if FD represents a directory, false if it
    represents an ordinary file. */
-static bool
-isdir (int fd)
+static uint32_t
+sys_isdir (uint32_t args[])
 {
+  int fd = args[0];
+
   struct file *f = process_get_file (fd);
   if (f == NULL)
     {
-      DEBUG_PRINT_SYSCALL_END (COLOR_HRED "[open %d failed]", fd);
+      DEBUG_PRINT (COLOR_HRED "[open %d failed]", fd);
       thread_exit ();
     }
   return file_is_dir (f);
@@ -779,14 +686,335 @@ isdir (int fd)
 
    An inode number persistently identifies a file or directory. It is
    unique during the file's existence. */
-static int
-inumber (int fd)
+static uint32_t
+sys_inumber (uint32_t args[])
 {
+  int fd = args[0];
+
   struct file *f = process_get_file (fd);
   if (f == NULL)
     {
-      DEBUG_PRINT_SYSCALL_END (COLOR_HRED "[open %d failed]", fd);
+      DEBUG_PRINT (COLOR_HRED "[open %d failed]", fd);
       thread_exit ();
     }
   return file_inumber (f);
 }
+
+/* Creates a pipe and stores descriptors for its reading and
+   writing ends into FDS[0] and FDS[1].  Returns true if
+   successful, false if memory is short.  Pipe descriptors are
+   inherited by processes started with exec(). */
+static uint32_t
+sys_pipe (uint32_t args[])
+{
+  int *ufds = (int *) args[0];
+  struct file *read_end, *write_end;
+  int fds[2];
+
+  check_buffer (ufds, sizeof fds, true);
+  if (!file_open_pipe (&read_end, &write_end))
+    return false;
+
+  fds[0] = process_allocate_fd (read_end);
+  fds[1] = fds[0] < 0 ? -1 : process_allocate_fd (write_end);
+  if (fds[1] < 0)
+    {
+      if (fds[0] >= 0)
+        process_free_fd (fds[0]);
+      file_close (read_end);
+      file_close (write_end);
+      return false;
+    }
+
+  if (!copy_to_user (ufds, fds, sizeof fds))
+    exit (-1);
+  return true;
+}
+
+/* Makes NEWFD refer to the file open as OLDFD, closing whatever
+   was open as NEWFD first.  Returns NEWFD, or -1 if OLDFD is not
+   open or NEWFD is out of range.  Unlike on Unix, the two
+   descriptors do not share a file position; NEWFD starts at
+   OLDFD's.  Closing a file installed as 0 or 1 this way returns
+   that descriptor to the console. */
+static uint32_t
+sys_dup2 (uint32_t args[])
+{
+  int oldfd = args[0];
+  int newfd = args[1];
+
+  struct file *f = process_get_file (oldfd);
+  if (f == NULL)
+    return -1;
+  if (oldfd == newfd)
+    return newfd;
+
+  struct file *copy = file_reopen (f);
+  if (copy == NULL)
+    return -1;
+  file_seek (copy, file_tell (f));
+  if (!process_install_fd (newfd, copy))
+    {
+      file_close (copy);
+      return -1;
+    }
+  return newfd;
+}
+
+/* Creates a shared memory segment of SIZE bytes, rounded up to
+   whole pages and initially zero.  Returns an identifier that any
+   process may pass to shm_attach(), or -1 on failure.  The
+   segment lasts while this process has not exited or attached it,
+   or any process has it attached. */
+static uint32_t
+sys_shm_create (uint32_t args[])
+{
+  return shm_create (args[0]);
+}
+
+/* Maps shared memory segment ID into this process and returns its
+   address, or a null pointer on failure. */
+static uint32_t
+sys_shm_attach (uint32_t args[])
+{
+  return (uint32_t) shm_attach (args[0]);
+}
+
+/* Unmaps the shared memory segment attached at ADDR.  Returns true
+   if successful, false if none is attached there or asynchronous
+   I/O in flight still uses it. */
+static uint32_t
+sys_shm_detach (uint32_t args[])
+{
+  return shm_detach ((void *) args[0]);
+}
+
+/* Maps a page of asynchronous I/O rings, laid out as a struct
+   aio_ring, into this process and returns its address, or a null
+   pointer on failure.  A process has at most one such page. */
+static uint32_t
+sys_aio_setup (uint32_t args[] UNUSED)
+{
+  return (uint32_t) aio_setup ();
+}
+
+/* Submits up to TO_SUBMIT requests from this process's submission
+   ring and waits until at least MIN_COMPLETE completions can be
+   reaped or none are pending.  Returns the number of requests
+   submitted, or -1 if the process has no rings. */
+static uint32_t
+sys_aio_enter (uint32_t args[])
+{
+  return aio_enter (args[0], args[1]);
+}
+
+/* Returns the file open as FD, which must not be the console.
+   Exits if FD is not open. */
+static struct file *
+get_file_or_exit (int fd)
+{
+  struct file *f = process_get_file (fd);
+  if (f != NULL)
+    return f;
+
+  DEBUG_PRINT (COLOR_HRED "[open %d failed]", fd);
+  thread_exit ();
+}
+
+/* Returns true if FD is standard input or output and no file has
+   been installed in its place, so that it refers to the console. */
+static bool
+is_console (int fd)
+{
+  return ((fd == STDIN_FILENO || fd == STDOUT_FILENO)
+          && process_get_file (fd) == NULL);
+}
+
+/* Reads SIZE bytes from the file open as FD into BUFFER, starting
+   at byte OFFSET, without changing the file's position.  Returns
+   the number of bytes actually read (0 at end of file), or -1 if
+   OFFSET is negative or FD cannot be read at an offset, like the
+   console, a pipe, or a directory. */
+static uint32_t
+sys_pread (uint32_t args[])
+{
+  int fd = args[0];
+  void *buffer = (void *) args[1];
+  unsigned size = args[2];
+  off_t offset = args[3];
+
+  if (offset < 0 || is_console (fd))
+    return -1;
+
+  struct file *f = get_file_or_exit (fd);
+  if (file_is_dir (f))
+    return -1;
+  return file_read_at (f, buffer, size, offset);
+}
+
+/* Writes SIZE bytes from BUFFER to the file open as FD, starting
+   at byte OFFSET, without changing the file's position.  Returns
+   the number of bytes actually written, or -1 if OFFSET is
+   negative or FD cannot be written at an offset, like the console,
+   a pipe, or a directory. */
+static uint32_t
+sys_pwrite (uint32_t args[])
+{
+  int fd = args[0];
+  const void *buffer = (const void *) args[1];
+  unsigned size = args[2];
+  off_t offset = args[3];
+
+  if (offset < 0 || is_console (fd))
+    return -1;
+
+  struct file *f = get_file_or_exit (fd);
+  if (file_is_dir (f))
+    return -1;
+  return file_write_at (f, buffer, size, offset);
+}
+
+/* Copies the IOVCNT buffer descriptors at UIOV into IOV and checks
+   that the buffers are mapped, and writable if WRITE.  Exits if
+   they are not.  Returns false if IOVCNT is out of range or the
+   buffers add up to more than fits in an off_t. */
+static bool
+copy_in_iovec (struct iovec *iov, const struct iovec *uiov, int iovcnt,
+               bool write)
+{
+  size_t total = 0;
+  int i;
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return false;
+  copy_in (iov, uiov, iovcnt * sizeof *iov);
+  for (i = 0; i < iovcnt; i++)
+    {
+      check_buffer (iov[i].iov_base, iov[i].iov_len, write);
+      if (iov[i].iov_len > INT32_MAX - total)
+        return false;
+      total += iov[i].iov_len;
+    }
+  return true;
+}
+
+/* Reads from the file open as FD into the IOVCNT buffers described
+   by IOV, in order, as one operation.  Returns the number of bytes
+   actually read (0 at end of file), or -1 if IOVCNT is negative or
+   more than IOV_MAX. */
+static uint32_t
+sys_readv (uint32_t args[])
+{
+  int fd = args[0];
+  const struct iovec *uiov = (const struct iovec *) args[1];
+  int iovcnt = args[2];
+  struct iovec iov[IOV_MAX];
+  int i;
+
+  if (!copy_in_iovec (iov, uiov, iovcnt, true))
+    return -1;
+
+  if (fd == STDIN_FILENO && process_get_file (fd) == NULL)
+    {
+      int total = 0;
+      for (i = 0; i < iovcnt; i++)
+        total += read_stdin (iov[i].iov_base, iov[i].iov_len);
+      return total;
+    }
+  return file_readv (get_file_or_exit (fd), iov, iovcnt);
+}
+
+/* Writes the IOVCNT buffers described by IOV, in order, to the
+   file open as FD as one operation.  Returns the number of bytes
+   actually written, or -1 if IOVCNT is negative or more than
+   IOV_MAX. */
+static uint32_t
+sys_writev (uint32_t args[])
+{
+  int fd = args[0];
+  const struct iovec *uiov = (const struct iovec *) args[1];
+  int iovcnt = args[2];
+  struct iovec iov[IOV_MAX];
+  int i;
+
+  if (!copy_in_iovec (iov, uiov, iovcnt, false))
+    return -1;
+
+  if (fd == STDOUT_FILENO && process_get_file (fd) == NULL)
+    {
+      int total = 0;
+      for (i = 0; i < iovcnt; i++)
+        total += write_stdout (iov[i].iov_base, iov[i].iov_len);
+      return total;
+    }
+  return file_writev (get_file_or_exit (fd), iov, iovcnt);
+}
+
+/* Copies up to LENGTH bytes from the file open as IN_FD, starting
+   at its position, to the file open as OUT_FD, starting at its
+   position, inside the kernel.  Advances both positions.  Returns
+   the number of bytes copied (0 at end of IN_FD), or -1 if either
+   descriptor is the console, a pipe, or a directory, if the two
+   refer to overlapping parts of one file, or if nothing could be
+   copied, for example because OUT_FD's file is a running
+   executable or the disk is full. */
+static uint32_t
+sys_copy_file_range (uint32_t args[])
+{
+  int in_fd = args[0];
+  int out_fd = args[1];
+  unsigned length = args[2];
+
+  if (is_console (in_fd) || is_console (out_fd))
+    return -1;
+  if (length > INT32_MAX)
+    length = INT32_MAX;
+  return file_copy (get_file_or_exit (out_fd), get_file_or_exit (in_fd),
+                    length);
+}
+
+/* Writes the file open as FD back to disk, data and metadata,
+   leaving other files' dirty blocks in the cache.  Returns 0 if
+   successful, or -1 if FD is the console or a pipe. */
+static uint32_t
+sys_fsync (uint32_t args[])
+{
+  int fd = args[0];
+
+  if (is_console (fd))
+    return -1;
+  return file_sync (get_file_or_exit (fd), false) ? 0 : -1;
+}
+
+/* Like fsync, but writes back the file's metadata only if the
+   file has grown, since nothing else is needed to read its data
+   back. */
+static uint32_t
+sys_fdatasync (uint32_t args[])
+{
+  int fd = args[0];
+
+  if (is_console (fd))
+    return -1;
+  return file_sync (get_file_or_exit (fd), true) ? 0 : -1;
+}
+
+/* Advises the kernel that the file open as FD will be accessed
+   with pattern ADVICE, one of the POSIX_FADV_* values, over the
+   LEN bytes starting at OFFSET, or through end of file if LEN is
+   0.  Returns 0 if successful, or -1 if OFFSET or LEN is
+   negative, ADVICE is unknown, or FD is the console or a pipe. */
+static uint32_t
+sys_fadvise (uint32_t args[])
+{
+  int fd = args[0];
+  int offset = args[1];
+  int len = args[2];
+  int advice = args[3];
+
+  if (is_console (fd))
+    return -1;
+  if (offset < 0 || len < 0)
+    return -1;
+  return file_advise (get_file_or_exit (fd), offset, len, advice) ? 0 : -1;
+}
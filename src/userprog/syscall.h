@@ -5,5 +5,6 @@
 #define WRITE_BUF_SIZE 512
 
 void syscall_init (void);
+void syscall_print_stats (void);
 
 #endif /* userprog/syscall.h */
@@ -2,6 +2,7 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/cpu.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -86,6 +87,20 @@ tss_init (void)
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
   tss_update ();
+
+  /* If the CPU has SYSENTER, point it at sysenter_entry() with
+     its stack pointer at esp0 above, where the entry stub finds
+     the current thread's kernel stack.  SYSENTER takes SS from
+     the GDT entry after CS, and SYSEXIT takes the user CS and SS
+     from the two after that, which gdt_init() arranges. */
+  if (cpu_features () & CPUID_SEP)
+    {
+      extern void sysenter_entry (void);
+
+      wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+      wrmsr (MSR_SYSENTER_ESP, (uintptr_t) &tss->esp0);
+      wrmsr (MSR_SYSENTER_EIP, (uintptr_t) sysenter_entry);
+    }
 }
 
 /* Returns the kernel TSS. */
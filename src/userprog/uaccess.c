@@ -0,0 +1,205 @@
+#include "userprog/uaccess.h"
+#include <debug.h>
+#include <round.h>
+#include "threads/vaddr.h"
+
+/* Every instruction below that touches user memory gets an entry
+   in the "__ex_table" section, which pairs the instruction's
+   address with the address of the code that should run instead
+   if it faults.  The linker script gathers all the entries
+   between __start___ex_table and __stop___ex_table. */
+
+/* An exception table entry. */
+struct exception_entry
+  {
+    uintptr_t insn;             /* Instruction that may fault. */
+    uintptr_t fixup;            /* Where to resume if it does. */
+  };
+
+/* Emits an exception table entry for labels INSN and FIXUP. */
+#define EX_TABLE(INSN, FIXUP)                                   \
+  ".pushsection __ex_table, \"a\"\n\t"                          \
+  ".long " #INSN ", " #FIXUP "\n\t"                             \
+  ".popsection\n\t"
+
+extern const struct exception_entry __start___ex_table[];
+extern const struct exception_entry __stop___ex_table[];
+
+/* Reads a byte at user virtual address UADDR.
+   UADDR must be below PHYS_BASE.
+   Returns the byte value if successful, -1 if a segfault
+   occurred. */
+int
+get_user (const uint8_t *uaddr)
+{
+  int result;
+  asm volatile ("movl $-1, %0\n"
+                "1: movzbl %1, %0\n"
+                "2:\n\t"
+                EX_TABLE (1b, 2b)
+                : "=&r" (result) : "m" (*uaddr));
+  return result;
+}
+
+/* Writes BYTE to user address UDST.
+   UDST must be below PHYS_BASE.
+   Returns true if successful, false if a segfault occurred. */
+bool
+put_user (uint8_t *udst, uint8_t byte)
+{
+  int ok;
+  asm volatile ("movl $0, %0\n"
+                "1: movb %b2, %1\n"
+                "movl $1, %0\n"
+                "2:\n\t"
+                EX_TABLE (1b, 2b)
+                : "=&r" (ok), "=m" (*udst) : "q" (byte));
+  return ok;
+}
+
+/* Copies SIZE bytes from SRC to DST, a word at a time and then a
+   byte at a time, where either may be a user address.  Returns
+   true if successful, false if a segfault occurred partway. */
+static bool
+copy_user (void *dst, const void *src, size_t size)
+{
+  size_t words = size / sizeof (uint32_t);
+  int ok;
+
+  asm volatile ("xorl %0, %0\n"
+                "1: rep movsl\n"
+                "movl %4, %%ecx\n"
+                "2: rep movsb\n"
+                "movl $1, %0\n"
+                "3:\n\t"
+                EX_TABLE (1b, 3b)
+                EX_TABLE (2b, 3b)
+                : "=&a" (ok), "+c" (words), "+S" (src), "+D" (dst)
+                : "d" (size % sizeof (uint32_t))
+                : "memory");
+  return ok;
+}
+
+/* Copies bytes from SRC to DST, where either may be a user
+   address, up to and including a null byte but no more than SIZE
+   bytes in all.  Returns the number of bytes copied before the
+   null byte, which is SIZE if none was found, or -1 if a segfault
+   occurred partway. */
+static int
+copy_user_string (char *dst, const char *src, size_t size)
+{
+  size_t left = size;
+  int ok;
+
+  asm volatile ("xorl %0, %0\n"
+                "jecxz 2f\n"
+                "1: lodsb\n"
+                "stosb\n"
+                "testb %%al, %%al\n"
+                "jz 2f\n"
+                "decl %%ecx\n"
+                "jnz 1b\n"
+                "2: movl $1, %0\n"
+                "3:\n\t"
+                EX_TABLE (1b, 3b)
+                : "=&d" (ok), "+c" (left), "+S" (src), "+D" (dst)
+                :
+                : "eax", "memory");
+  return ok ? (int) (size - left) : -1;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel buffer DST.
+   Returns true if successful, false if any part of the user
+   range is not mapped or not in user space. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return user_range_ok (usrc, size) && copy_user (dst, usrc, size);
+}
+
+/* Copies SIZE bytes from kernel buffer SRC to user address UDST.
+   Returns true if successful, false if any part of the user
+   range is not mapped, read-only, or not in user space. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return user_range_ok (udst, size) && copy_user (udst, src, size);
+}
+
+/* Copies the null-terminated string at user address USRC into
+   DST, copying at most SIZE bytes including the null terminator.
+   Returns the length of the string, not counting the null
+   terminator; SIZE if the string did not end within SIZE bytes,
+   in which case DST is not null-terminated; or -1 if the string
+   runs into unmapped memory or kernel space. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  size_t copied = 0;
+
+  /* Copy a page at a time, so that the range check covers every
+     byte copied without knowing the string's length up front. */
+  while (copied < size)
+    {
+      const char *src = usrc + copied;
+      size_t page_left = PGSIZE - pg_ofs (src);
+      size_t chunk = size - copied < page_left ? size - copied : page_left;
+      int len;
+
+      if (!user_range_ok (src, chunk))
+        return -1;
+      len = copy_user_string (dst + copied, src, chunk);
+      if (len < 0)
+        return -1;
+      if ((size_t) len < chunk)
+        return copied + len;
+      copied += chunk;
+    }
+  return size;
+}
+
+/* Returns true if the SIZE bytes starting at UADDR lie entirely
+   within user space, without checking whether they are mapped. */
+bool
+user_range_ok (const void *uaddr, size_t size)
+{
+  uintptr_t start = (uintptr_t) uaddr;
+
+  return start + size >= start
+         && start + size <= (uintptr_t) PHYS_BASE;
+}
+
+/* Returns true if all SIZE bytes starting at UADDR are mapped
+   user memory, and writable too if WRITE is true.  Touches only
+   one byte per page, so the cost grows with the number of pages
+   rather than bytes.  A null UADDR is never valid. */
+bool
+probe_user (const void *uaddr, size_t size, bool write)
+{
+  const uint8_t *p = uaddr;
+  const uint8_t *end = p + size;
+
+  if (uaddr == NULL || !user_range_ok (uaddr, size))
+    return false;
+
+  for (; p < end; p = (const uint8_t *) pg_round_down (p) + PGSIZE)
+    {
+      int c = get_user (p);
+      if (c < 0 || (write && !put_user ((uint8_t *) p, c)))
+        return false;
+    }
+  return true;
+}
+
+/* Returns the fixup address for a fault at EIP, or a null
+   pointer if the instruction at EIP was not expected to fault. */
+void *
+search_exception_table (const void *eip)
+{
+  const struct exception_entry *e;
+
+  for (e = __start___ex_table; e < __stop___ex_table; e++)
+    if (e->insn == (uintptr_t) eip)
+      return (void *) e->fixup;
+  return NULL;
+}
@@ -0,0 +1,26 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Access to user memory from the kernel.
+
+   None of these functions check in advance whether user pages
+   are mapped.  They just access them, and if that faults,
+   page_fault() finds the faulting instruction in the exception
+   table and resumes at its fixup code, which reports failure to
+   the caller. */
+
+int get_user (const uint8_t *uaddr);
+bool put_user (uint8_t *udst, uint8_t byte);
+bool copy_from_user (void *dst, const void *usrc, size_t size);
+bool copy_to_user (void *udst, const void *src, size_t size);
+int strncpy_from_user (char *dst, const char *usrc, size_t size);
+bool user_range_ok (const void *uaddr, size_t size);
+bool probe_user (const void *uaddr, size_t size, bool write);
+
+void *search_exception_table (const void *eip);
+
+#endif /* userprog/uaccess.h */